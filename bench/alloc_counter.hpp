@@ -0,0 +1,79 @@
+#pragma once
+
+// Counts heap allocations by interposing the glibc malloc family.
+// This covers `operator new` as well as allocations made inside cnats.
+// Include in exactly one translation unit of a benchmark executable.
+
+#include <cstddef>
+#include <cstdint>
+#include <atomic>
+
+extern "C"
+{
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t n, size_t size);
+void* __libc_realloc(void* ptr, size_t size);
+void* __libc_memalign(size_t alignment, size_t size);
+void __libc_free(void* ptr);
+}
+
+namespace alloc_counter
+{
+/**
+ * Allocations made by the calling thread.
+ */
+inline thread_local uint64_t thread_allocs = 0;
+
+/**
+ * Allocations made by all threads of the process.
+ */
+inline std::atomic<uint64_t> total_allocs{0};
+
+inline void count() noexcept
+{
+    ++thread_allocs;
+    total_allocs.fetch_add(1, std::memory_order_relaxed);
+}
+} // namespace alloc_counter
+
+extern "C"
+{
+void* malloc(size_t size) noexcept
+{
+    alloc_counter::count();
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t n, size_t size) noexcept
+{
+    alloc_counter::count();
+    return __libc_calloc(n, size);
+}
+
+void* realloc(void* ptr, size_t size) noexcept
+{
+    alloc_counter::count();
+    return __libc_realloc(ptr, size);
+}
+
+void* aligned_alloc(size_t alignment, size_t size) noexcept
+{
+    alloc_counter::count();
+    return __libc_memalign(alignment, size);
+}
+
+int posix_memalign(void** out, size_t alignment, size_t size) noexcept
+{
+    alloc_counter::count();
+    void* ptr = __libc_memalign(alignment, size);
+    if (!ptr)
+        return 12; // ENOMEM
+    *out = ptr;
+    return 0;
+}
+
+void free(void* ptr) noexcept
+{
+    __libc_free(ptr);
+}
+}
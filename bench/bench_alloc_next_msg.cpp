@@ -0,0 +1,234 @@
+#include <iostream>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <format>
+#include <expected>
+#include <thread>
+#include <vector>
+#include <span>
+#include <algorithm>
+
+#include "nats_client/Client.hpp"
+#include "alloc_counter.hpp"
+
+using std::string;
+using std::expected;
+using std::unexpected;
+using std::vector;
+using std::span;
+using std::byte;
+
+// Measures heap allocations of the `next_msg` / `next_msgs` receive path:
+//
+// - per poll of an idle subscription, i.e. when every call runs into its timeout
+// - per received message. "receiver" counts the allocations made by the receiving thread,
+//   "process" also counts the cnats reader thread, which allocates every incoming message
+//   before it is queued to the subscription, and the publishing thread. The difference is
+//   the per-message floor set by cnats, which the wrapper cannot avoid.
+// Requires a NATS server running on localhost:4222.
+
+const char* subject = "bench_alloc_idle";
+const char* recv_subject = "bench_alloc_recv";
+const int64_t timeout_ms = 1;
+const int64_t recv_timeout_ms = 1'000;
+const int polls = 2'000;
+const size_t payload_size = 256;
+const size_t batch_size = 64;
+const int warmup_msgs = 2'000;
+const int msgs = 50'000;
+
+template <typename F>
+expected<void, nats::NatsError> measure(const char* name, F&& poll)
+{
+    // warm up thread-local state inside cnats
+    for (int i = 0; i < 100; ++i)
+    {
+        auto res = poll();
+        if (!res)
+            return unexpected(res.error());
+    }
+
+    uint64_t allocs_before = alloc_counter::thread_allocs;
+    for (int i = 0; i < polls; ++i)
+    {
+        auto res = poll();
+        if (!res)
+            return unexpected(res.error());
+    }
+    uint64_t allocs = alloc_counter::thread_allocs - allocs_before;
+
+    std::cout << std::format(
+        "{:<14} {} polls, {} allocs, {:.3f} allocs/poll\n",
+        name,
+        polls,
+        allocs,
+        static_cast<double>(allocs) / polls
+    );
+    return {}; // Success
+}
+
+/**
+ * Publishes `warmup_msgs + msgs` messages while `receive(n)` takes up to `n` messages and
+ * returns how many it took, counting allocations over the last `msgs` messages.
+ */
+template <typename F>
+expected<void, nats::NatsError> measure_recv(
+    const char* name, nats::NatsClient& client, nats::NatsSubscriptionSync& sub, F&& receive
+)
+{
+    std::jthread publisher(
+        [&client]()
+        {
+            vector<byte> payload(payload_size);
+            for (int i = 0; i < warmup_msgs + msgs; ++i)
+            {
+                if (!client.publish(recv_subject, span<const byte>(payload)))
+                    return;
+            }
+            (void)client.flush(recv_timeout_ms);
+        }
+    );
+
+    for (int n = 0; n < warmup_msgs;)
+    {
+        auto res = receive(warmup_msgs - n);
+        if (!res)
+            return unexpected(res.error());
+        n += res.value();
+    }
+
+    uint64_t thread_before = alloc_counter::thread_allocs;
+    uint64_t total_before = alloc_counter::total_allocs.load();
+    for (int n = 0; n < msgs;)
+    {
+        auto res = receive(msgs - n);
+        if (!res)
+            return unexpected(res.error());
+        n += res.value();
+    }
+    uint64_t thread_allocs = alloc_counter::thread_allocs - thread_before;
+    uint64_t total_allocs = alloc_counter::total_allocs.load() - total_before;
+
+    auto res_dropped = sub.get_dropped();
+    std::cout << std::format(
+        "{:<14} {} msgs, receiver {:.3f} allocs/msg, process {:.3f} allocs/msg, {} dropped\n",
+        name,
+        msgs,
+        static_cast<double>(thread_allocs) / msgs,
+        static_cast<double>(total_allocs) / msgs,
+        res_dropped ? res_dropped.value() : -1
+    );
+    return {}; // Success
+}
+
+expected<void, nats::NatsError> run()
+{
+    auto res0 = nats::NatsClient::create();
+    if (!res0)
+        return unexpected(res0.error());
+    nats::NatsClient& client = res0.value();
+
+    client
+        .options() //
+        .set_url("nats://localhost:4222");
+
+    auto res = client.connect();
+    if (!res)
+        return unexpected(res.error());
+
+    auto res_sub = client.subscribe_sync(subject);
+    if (!res_sub)
+        return unexpected(res_sub.error());
+    nats::NatsSubscriptionSync& sub = res_sub.value();
+
+    // `next_msg` reports timeouts as status-only errors
+    auto res1 = measure(
+        "next_msg",
+        [&]() -> expected<void, nats::NatsError>
+        {
+            auto res_msg = sub.next_msg(timeout_ms);
+            if (!res_msg && res_msg.error().status != NATS_TIMEOUT)
+                return unexpected(res_msg.error());
+            return {};
+        }
+    );
+    if (!res1)
+        return res1;
+
+    // `try_next_msg` reports timeouts as empty results
+    auto res2 = measure(
+        "try_next_msg",
+        [&]() -> expected<void, nats::NatsError>
+        {
+            auto res_msg = sub.try_next_msg(timeout_ms);
+            if (!res_msg)
+                return unexpected(res_msg.error());
+            return {};
+        }
+    );
+    if (!res2)
+        return res2;
+
+    auto res_recv = client.subscribe_sync(recv_subject);
+    if (!res_recv)
+        return unexpected(res_recv.error());
+    nats::NatsSubscriptionSync& recv = res_recv.value();
+
+    res = client.flush(recv_timeout_ms);
+    if (!res)
+        return unexpected(res.error());
+
+    // one message per call, destroyed right away
+    auto res3 = measure_recv(
+        "next_msg",
+        client,
+        recv,
+        [&](int) -> expected<int, nats::NatsError>
+        {
+            auto res_msg = recv.next_msg(recv_timeout_ms);
+            if (!res_msg)
+                return unexpected(res_msg.error());
+            return 1;
+        }
+    );
+    if (!res3)
+        return res3;
+
+    // batches, the slots of `batch` release the previous messages when overwritten
+    vector<nats::NatsMessageView> batch(batch_size);
+    auto res4 = measure_recv(
+        "next_msgs",
+        client,
+        recv,
+        [&](int max) -> expected<int, nats::NatsError>
+        {
+            span<nats::NatsMessageView> out(batch.data(), std::min<size_t>(batch_size, max));
+            auto res_n = recv.next_msgs(out, recv_timeout_ms);
+            if (!res_n)
+                return unexpected(res_n.error());
+            if (res_n.value() == 0)
+                return unexpected(nats::NatsError(NATS_TIMEOUT));
+            return static_cast<int>(res_n.value());
+        }
+    );
+    if (!res4)
+        return res4;
+
+    return {}; // Success
+}
+
+int main()
+{
+    auto ret = run();
+
+    nats_Close();
+
+    if (!ret)
+    {
+        std::cerr << ret.error().to_string() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -1,32 +1,156 @@
 #include <iostream>
+#include <fstream>
 #include <cstddef>
+#include <cstdint>
+#include <cstring>
 #include <string>
+#include <string_view>
 #include <format>
 #include <expected>
 #include <thread>
 #include <chrono>
+#include <atomic>
 #include <span>
-#include <time.h>
+#include <vector>
+#include <charconv>
 
 #include "nats_client/Client.hpp"
+#include "latency_histogram.hpp"
 
 using std::string;
+using std::string_view;
 using std::expected;
 using std::unexpected;
 using std::span;
 using std::byte;
+using std::vector;
 using namespace std::chrono;
 
+// Publish-to-receive latency over a local NATS server.
+//
+// Usage: bench_lat_pub_sub [--url URL] [--payload BYTES] [--rate MSGS_PER_SEC[,...]]
+//                          [--duration SECONDS] [--csv FILE] [--json FILE]
+//
+// The producer is open-loop: message i is scheduled at `start + i / rate` and carries
+// its intended send time, from which latency is measured. If publishing falls behind
+// (e.g. backpressure), the producer catches up without skipping messages, so queueing
+// delay shows up in the latency instead of being hidden (coordinated omission).
+//
+// Multiple comma-separated rates run one after the other, to find the knee of the
+// latency/throughput curve. A rate of 0 publishes as fast as possible (closed-loop)
+// and measures latency from the actual send time.
+//
+// Past the knee the consumer cannot keep up and cnats drops messages once the pending
+// limits of the subscription are reached. The sweep continues: slow consumer events and
+// dropped messages are reported per rate as the saturation marker. Only connection-level
+// errors abort the sweep, and the rate that failed is not reported.
+//
+// CSV output appends one row per rate (header is written if the file is empty),
+// JSON output overwrites the file with an array of results.
+
 const char* subject = "bench_latency";
 
+struct Config
+{
+    string url = "nats://localhost:4222";
+    size_t payload_size = sizeof(int64_t);
+    vector<int64_t> rates = {100'000};
+    int64_t duration_s = 10;
+    string csv_path;
+    string json_path;
+};
+
+const double percentiles[] = {50.0, 90.0, 99.0, 99.9, 99.99};
+
+struct Result
+{
+    int64_t rate;
+    double achieved_rate;
+    LatencyHistogram histogram;
+    // `NATS_SLOW_CONSUMER` errors seen by the consumer, and messages dropped by cnats
+    int64_t slow_consumer_events;
+    int64_t dropped_msgs;
+};
+
+std::atomic<bool> consumer_ready{false};
+std::atomic<bool> producer_done{false};
+std::atomic<bool> failed{false};
+
 int64_t nanos() noexcept
 {
-    auto now = high_resolution_clock::now();
+    auto now = steady_clock::now();
     auto duration = now.time_since_epoch();
     return duration_cast<nanoseconds>(duration).count();
 }
 
-expected<void, nats::NatsError> run_producer()
+template <typename T>
+bool parse_number(string_view str, T& out) noexcept
+{
+    auto [end, ec] = std::from_chars(str.data(), str.data() + str.size(), out);
+    return ec == std::errc() && end == str.data() + str.size();
+}
+
+bool parse_rates(string_view str, vector<int64_t>& out) noexcept
+{
+    out.clear();
+    while (!str.empty())
+    {
+        size_t pos = str.find(',');
+        int64_t rate;
+        if (!parse_number(str.substr(0, pos), rate) || rate < 0)
+            return false;
+        out.push_back(rate);
+        str = pos == string_view::npos ? string_view() : str.substr(pos + 1);
+    }
+    return !out.empty();
+}
+
+// Sleeps until shortly before the target time, then spins for precision.
+void wait_until(int64_t target_ns) noexcept
+{
+    while (true)
+    {
+        int64_t remaining = target_ns - nanos();
+        if (remaining <= 0)
+            return;
+        if (remaining > 100'000)
+            std::this_thread::sleep_for(nanoseconds(remaining - 50'000));
+    }
+}
+
+expected<Config, string> parse_args(int argc, char** argv)
+{
+    Config cfg;
+    for (int i = 1; i < argc; ++i)
+    {
+        string_view arg = argv[i];
+        if (i + 1 >= argc)
+            return unexpected(std::format("Missing value for argument [{}].", arg));
+        string_view value = argv[++i];
+
+        bool ok = true;
+        if (arg == "--url")
+            cfg.url = value;
+        else if (arg == "--payload")
+            ok = parse_number(value, cfg.payload_size) && cfg.payload_size >= sizeof(int64_t);
+        else if (arg == "--rate")
+            ok = parse_rates(value, cfg.rates);
+        else if (arg == "--duration")
+            ok = parse_number(value, cfg.duration_s) && cfg.duration_s > 0;
+        else if (arg == "--csv")
+            cfg.csv_path = value;
+        else if (arg == "--json")
+            cfg.json_path = value;
+        else
+            return unexpected(std::format("Unknown argument [{}].", arg));
+
+        if (!ok)
+            return unexpected(std::format("Invalid value [{}] for argument [{}].", value, arg));
+    }
+    return cfg;
+}
+
+expected<nats::NatsClient, nats::NatsError> connect(const Config& cfg)
 {
     auto res0 = nats::NatsClient::create();
     if (!res0)
@@ -34,123 +158,324 @@ expected<void, nats::NatsError> run_producer()
     nats::NatsClient& client = res0.value();
 
     client
-        .options()                        //
-        .set_url("nats://localhost:4222") //
-        .set_send_asap(true) //
-        ;
+        .options()        //
+        .set_url(cfg.url) //
+        .set_send_asap(true);
 
     auto res = client.connect();
     if (!res)
         return unexpected(res.error());
 
+    return std::move(client);
+}
+
+expected<void, nats::NatsError> run_producer(const Config& cfg, int64_t rate)
+{
+    auto res_client = connect(cfg);
+    if (!res_client)
+        return unexpected(res_client.error());
+    nats::NatsClient& client = res_client.value();
+
     std::cout << "Max payload size: " << client.get_max_payload() / 1024 << " KB\n";
 
-    // string payload = "Hello, World!";
-    for (int i = 0; i < 100'000'000; ++i)
+    auto res_subject = nats::NatsSubject::create(subject);
+    if (!res_subject)
+        return unexpected(res_subject.error());
+    const nats::NatsSubject& pub_subject = res_subject.value();
+
+    while (!consumer_ready.load())
+        std::this_thread::sleep_for(milliseconds(1));
+
+    vector<byte> payload(cfg.payload_size);
+    int64_t start = nanos();
+    int64_t end = start + cfg.duration_s * 1'000'000'000;
+
+    for (int64_t i = 0; !failed.load(std::memory_order_relaxed); ++i)
     {
-        auto nanoseconds = nanos();
-        span<const byte> payload{reinterpret_cast<const byte*>(&nanoseconds), sizeof(nanoseconds)};
-        auto res_pub = client.publish(subject, payload);
+        // open-loop: timestamp is the intended send time, not the actual one
+        int64_t ts = rate > 0 ? start + i * 1'000'000'000 / rate : nanos();
+        if (ts >= end)
+            break;
+        if (rate > 0)
+            wait_until(ts);
+
+        std::memcpy(payload.data(), &ts, sizeof(ts));
+        auto res_pub = client.publish(pub_subject, span<const byte>(payload));
         if (!res_pub)
             return unexpected(res_pub.error());
-        // if (i % 100 == 0)
-        //     std::cout << std::format("Published message: {}\n", i);
-
-        // nats_Sleep(0);
-        // std::this_thread::sleep_for(std::chrono::nanoseconds(1'000));
-        struct timespec ts = {0, 1'000}; // 1 us
-        nanosleep(&ts, NULL);
     }
 
     return {}; // Success
 }
 
-expected<void, nats::NatsError> run_consumer()
+expected<void, nats::NatsError> run_consumer(const Config& cfg, Result& result)
 {
-    auto res0 = nats::NatsClient::create();
-    if (!res0)
-        return unexpected(res0.error());
-    nats::NatsClient& client = res0.value();
-
-    client
-        .options()                        //
-        .set_url("nats://localhost:4222") //
-        .set_send_asap(true);
-
-    auto res = client.connect();
-    if (!res)
-        return unexpected(res.error());
+    auto res_client = connect(cfg);
+    if (!res_client)
+        return unexpected(res_client.error());
+    nats::NatsClient& client = res_client.value();
 
-    auto res_test = client.subscribe_sync(subject);
-    if (!res_test)
-        return unexpected(res_test.error());
+    auto res_sub = client.subscribe_sync(subject);
+    if (!res_sub)
+        return unexpected(res_sub.error());
+    nats::NatsSubscriptionSync& sub = res_sub.value();
 
-    nats::NatsSubscriptionSync& sub = res_test.value();
-    // sub.no_delivery_delay();
+    // make sure the subscription is registered before the producer starts
+    auto res_flush = client.flush(5'000);
+    if (!res_flush)
+        return unexpected(res_flush.error());
+    consumer_ready.store(true);
 
-    int64_t counter = 0;
-    int64_t latency_sum = 0;
-    auto last_time = high_resolution_clock::now();
+    LatencyHistogram& total = result.histogram;
+    LatencyHistogram interval;
+    int64_t first_ns = 0;
+    int64_t last_ns = 0;
+    auto last_time = steady_clock::now();
     while (true)
     {
-        auto res_msg = sub.next_msg(99999999);
+        auto res_msg = sub.try_next_msg(100);
         auto ns = nanos();
         if (!res_msg)
+        {
+            // reported once per overflow, the subscription keeps receiving
+            if (res_msg.error().status == NATS_SLOW_CONSUMER)
+            {
+                ++result.slow_consumer_events;
+                continue;
+            }
             return unexpected(res_msg.error());
+        }
 
-        ++counter;
-
-        int64_t msg_ts = *reinterpret_cast<const int64_t*>(res_msg.value().data().data());
-        int64_t latency = ns - msg_ts;
-        latency_sum += latency;
+        if (res_msg.value().has_value())
+        {
+            int64_t msg_ts;
+            std::memcpy(&msg_ts, res_msg.value()->data().data(), sizeof(msg_ts));
+            int64_t latency = ns - msg_ts;
+            interval.record(latency);
+            total.record(latency);
+            if (first_ns == 0)
+                first_ns = ns;
+            last_ns = ns;
+        }
+        else if (producer_done.load())
+        {
+            break; // all published messages received
+        }
 
-        auto time = high_resolution_clock::now();
-        if (duration_cast<seconds>(time - last_time).count() >= 1)
+        auto time = steady_clock::now();
+        if (time - last_time >= seconds(1))
         {
-            auto throughput = counter / duration_cast<seconds>(time - last_time).count();
-            auto avg_latency = latency_sum / counter;
-            std::cout << std::format("{} msgs/s, avg. latency {} ns\n", throughput, avg_latency);
-            counter = 0;
-            latency_sum = 0;
+            auto elapsed_s = duration_cast<duration<double>>(time - last_time).count();
+            std::cout << std::format(
+                "{:.0f} msgs/s, latency p50 {} ns, p99 {} ns, max {} ns\n",
+                static_cast<double>(interval.count()) / elapsed_s,
+                interval.percentile(50.0),
+                interval.percentile(99.0),
+                interval.max()
+            );
+            interval.reset();
             last_time = time;
         }
     }
 
+    if (last_ns > first_ns)
+        result.achieved_rate = static_cast<double>(total.count()) * 1e9 / (last_ns - first_ns);
+
+    auto res_stats = sub.stats();
+    if (!res_stats)
+        return unexpected(res_stats.error());
+    result.dropped_msgs = res_stats.value().dropped_msgs;
+
     return {}; // Success
 }
 
-int main()
+void print_report(const Config& cfg, const Result& r)
 {
-    // run producer in thread
-    std::jthread producer_thread(
-        []()
+    const LatencyHistogram& h = r.histogram;
+    std::cout << std::format(
+        "\n{} msgs, payload {} bytes, rate {} msgs/s (achieved {:.0f}), {} s\n",
+        h.count(),
+        cfg.payload_size,
+        r.rate,
+        r.achieved_rate,
+        cfg.duration_s
+    );
+    std::cout << std::format("  min    {:>12} ns\n", h.min());
+    std::cout << std::format("  mean   {:>12.0f} ns\n", h.mean());
+    for (double p : percentiles)
+        std::cout << std::format("  p{:<5} {:>12} ns\n", p, h.percentile(p));
+    std::cout << std::format("  max    {:>12} ns\n", h.max());
+    if (r.slow_consumer_events > 0 || r.dropped_msgs > 0)
+    {
+        std::cout << std::format(
+            "  saturated: {} slow consumer events, {} msgs dropped\n",
+            r.slow_consumer_events,
+            r.dropped_msgs
+        );
+    }
+}
+
+void print_sweep(const vector<Result>& results)
+{
+    std::cout << std::format(
+        "\n{:>12} {:>12} {:>12} {:>12} {:>12} {:>12} {:>12} {:>12}\n",
+        "rate",
+        "achieved",
+        "p50 ns",
+        "p99 ns",
+        "p99.9 ns",
+        "max ns",
+        "slow cons.",
+        "dropped"
+    );
+    for (const Result& r : results)
+    {
+        const LatencyHistogram& h = r.histogram;
+        std::cout << std::format(
+            "{:>12} {:>12.0f} {:>12} {:>12} {:>12} {:>12} {:>12} {:>12}\n",
+            r.rate,
+            r.achieved_rate,
+            h.percentile(50.0),
+            h.percentile(99.0),
+            h.percentile(99.9),
+            h.max(),
+            r.slow_consumer_events,
+            r.dropped_msgs
+        );
+    }
+}
+
+void write_csv(const Config& cfg, const vector<Result>& results)
+{
+    std::ofstream out(cfg.csv_path, std::ios::app);
+    if (out.tellp() == 0)
+    {
+        out << "payload_bytes,rate,achieved_rate,duration_s,count,min_ns,mean_ns,"
+               "p50_ns,p90_ns,p99_ns,p99.9_ns,p99.99_ns,max_ns,slow_consumer_events,dropped_msgs\n";
+    }
+    for (const Result& r : results)
+    {
+        const LatencyHistogram& h = r.histogram;
+        out << std::format(
+            "{},{},{:.0f},{},{},{},{:.0f}",
+            cfg.payload_size,
+            r.rate,
+            r.achieved_rate,
+            cfg.duration_s,
+            h.count(),
+            h.min(),
+            h.mean()
+        );
+        for (double p : percentiles)
+            out << std::format(",{}", h.percentile(p));
+        out << std::format(",{},{},{}\n", h.max(), r.slow_consumer_events, r.dropped_msgs);
+    }
+}
+
+void write_json(const Config& cfg, const vector<Result>& results)
+{
+    std::ofstream out(cfg.json_path, std::ios::trunc);
+    out << "[\n";
+    for (size_t r = 0; r < results.size(); ++r)
+    {
+        const LatencyHistogram& h = results[r].histogram;
+        out << std::format(
+            "  {{\"payload_bytes\": {}, \"rate\": {}, \"achieved_rate\": {:.0f}, "
+            "\"duration_s\": {}, \"count\": {}, \"min_ns\": {}, \"mean_ns\": {:.0f}, "
+            "\"percentiles_ns\": {{",
+            cfg.payload_size,
+            results[r].rate,
+            results[r].achieved_rate,
+            cfg.duration_s,
+            h.count(),
+            h.min(),
+            h.mean()
+        );
+        for (size_t i = 0; i < std::size(percentiles); ++i)
         {
-            auto ret = run_producer();
-            if (!ret)
+            double p = percentiles[i];
+            out << std::format("{}\"p{}\": {}", i ? ", " : "", p, h.percentile(p));
+        }
+        out << std::format(
+            "}}, \"max_ns\": {}, \"slow_consumer_events\": {}, \"dropped_msgs\": {}}}{}\n",
+            h.max(),
+            results[r].slow_consumer_events,
+            results[r].dropped_msgs,
+            r + 1 < results.size() ? "," : ""
+        );
+    }
+    out << "]\n";
+}
+
+int main(int argc, char** argv)
+{
+    auto res_cfg = parse_args(argc, argv);
+    if (!res_cfg)
+    {
+        std::cerr << res_cfg.error() << std::endl;
+        return 1;
+    }
+    const Config& cfg = res_cfg.value();
+
+    vector<Result> results;
+    results.reserve(cfg.rates.size());
+
+    for (int64_t rate : cfg.rates)
+    {
+        Result& result = results.emplace_back(Result{rate, 0.0, {}, 0, 0});
+        consumer_ready.store(false);
+        producer_done.store(false);
+
+        // run consumer in thread
+        std::jthread consumer_thread(
+            [&]()
             {
-                std::cerr << ret.error().to_string() << std::endl;
+                auto ret = run_consumer(cfg, result);
+                if (!ret)
+                {
+                    std::cerr << ret.error().to_string() << std::endl;
+                    failed.store(true);
+                    consumer_ready.store(true);
+                }
             }
-        }
-    );
+        );
 
-    // run consumer in thread
-    std::jthread consumer_thread(
-        []()
-        {
-            auto ret = run_consumer();
-            if (!ret)
+        // run producer in thread
+        std::jthread producer_thread(
+            [&]()
             {
-                std::cerr << ret.error().to_string() << std::endl;
+                auto ret = run_producer(cfg, rate);
+                if (!ret)
+                {
+                    std::cerr << ret.error().to_string() << std::endl;
+                    failed.store(true);
+                }
+                producer_done.store(true);
             }
+        );
+
+        producer_thread.join();
+        consumer_thread.join();
+
+        if (failed.load())
+        {
+            // incomplete, not written to the outputs
+            results.pop_back();
+            break;
         }
-    );
+        print_report(cfg, result);
+    }
 
-    producer_thread.join();
-    consumer_thread.join();
+    if (results.size() > 1)
+        print_sweep(results);
+    if (!cfg.csv_path.empty())
+        write_csv(cfg, results);
+    if (!cfg.json_path.empty())
+        write_json(cfg, results);
 
     std::cout << "Done\n";
 
     nats_Close();
 
-    return 0;
+    return failed.load() ? 1 : 0;
 }
@@ -0,0 +1,156 @@
+#include <cstddef>
+#include <cstdint>
+#include <atomic>
+#include <string>
+#include <expected>
+#include <vector>
+#include <span>
+#include <benchmark/benchmark.h>
+
+#include "nats_client/Client.hpp"
+
+using std::string;
+using std::expected;
+using std::unexpected;
+using std::vector;
+using std::span;
+using std::byte;
+
+// JetStream ingest throughput of `js_publish_async` for various in-flight windows,
+// with `js_publish` (one ack round trip per message) as baseline.
+// Requires a NATS server with JetStream enabled running on localhost:4222.
+//
+// The messages go to the (file backed) stream of a KV bucket, so no stream needs to be
+// set up beforehand: the bucket keeps one message per key, which bounds the stream size.
+
+const char* bucket = "bench_js_publish";
+const char* subject = "$KV.bench_js_publish.key";
+const int batch_size = 1024;
+const int64_t complete_timeout_ms = 30'000;
+const size_t payload_size = 128;
+
+expected<nats::NatsClient, nats::NatsError> connect(nats::JsConfig config)
+{
+    auto res0 = nats::NatsClient::create();
+    if (!res0)
+        return unexpected(res0.error());
+    nats::NatsClient& client = res0.value();
+
+    client.options().set_url("nats://localhost:4222");
+
+    auto res = client.connect();
+    if (!res)
+        return unexpected(res.error());
+
+    res = client.jet_stream(std::move(config));
+    if (!res)
+        return unexpected(res.error());
+
+    // binds to the bucket if it already exists with the same configuration
+    auto res_kv = client.kvs_create(bucket);
+    if (!res_kv)
+        return unexpected(res_kv.error());
+
+    return std::move(client);
+}
+
+void set_counters(benchmark::State& state)
+{
+    int64_t msgs = state.iterations() * batch_size;
+    state.SetItemsProcessed(msgs);
+    state.SetBytesProcessed(msgs * static_cast<int64_t>(payload_size));
+}
+
+// One `js_publish` per message, waiting for each ack.
+void BM_js_publish_sync(benchmark::State& state)
+{
+    auto res_client = connect({});
+    if (!res_client)
+    {
+        state.SkipWithError(res_client.error().to_string().c_str());
+        return;
+    }
+    nats::NatsClient& client = res_client.value();
+
+    vector<byte> payload(payload_size);
+
+    for (auto _ : state)
+    {
+        for (int i = 0; i < batch_size; ++i)
+        {
+            auto res = client.js_publish(subject, span<const byte>(payload));
+            if (!res)
+            {
+                state.SkipWithError(res.error().to_string().c_str());
+                return;
+            }
+        }
+    }
+
+    set_counters(state);
+}
+
+// `js_publish_async` with a window of `state.range(0)` messages awaiting their ack,
+// every batch is completed (all acks received) before the next iteration.
+void BM_js_publish_async(benchmark::State& state)
+{
+    std::atomic<int64_t> failed_acks{0};
+
+    nats::JsConfig config;
+    config.max_pending = state.range(0);
+    config.stall_wait_ms = complete_timeout_ms;
+    config.ack_handler = [&](nats::NatsMessageView&, auto ack)
+    {
+        if (!ack)
+            failed_acks.fetch_add(1, std::memory_order_relaxed);
+    };
+
+    auto res_client = connect(std::move(config));
+    if (!res_client)
+    {
+        state.SkipWithError(res_client.error().to_string().c_str());
+        return;
+    }
+    nats::NatsClient& client = res_client.value();
+
+    vector<byte> payload(payload_size);
+
+    for (auto _ : state)
+    {
+        for (int i = 0; i < batch_size; ++i)
+        {
+            auto res = client.js_publish_async(subject, span<const byte>(payload));
+            if (!res)
+            {
+                state.SkipWithError(res.error().to_string().c_str());
+                return;
+            }
+        }
+
+        auto res = client.js_publish_async_complete(complete_timeout_ms);
+        if (!res)
+        {
+            state.SkipWithError(res.error().to_string().c_str());
+            return;
+        }
+    }
+
+    set_counters(state);
+    state.counters["failed_acks"] = static_cast<double>(failed_acks.load());
+}
+
+BENCHMARK(BM_js_publish_sync)->UseRealTime();
+BENCHMARK(BM_js_publish_async)->RangeMultiplier(4)->Range(1, 4096)->UseRealTime();
+
+int main(int argc, char** argv)
+{
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv))
+        return 1;
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+
+    nats_Close();
+
+    return 0;
+}
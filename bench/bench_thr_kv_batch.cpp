@@ -0,0 +1,232 @@
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <format>
+#include <expected>
+#include <vector>
+#include <span>
+#include <benchmark/benchmark.h>
+
+#include "nats_client/Client.hpp"
+
+using std::string;
+using std::string_view;
+using std::expected;
+using std::unexpected;
+using std::vector;
+using std::span;
+using std::byte;
+
+// KV throughput in keys/s of `kv_put_many` and `kv_get_many` for various pipeline depths,
+// with `kv_put` / `kv_get` (one blocking round trip per key) as baseline.
+// Requires a NATS server with JetStream enabled running on localhost:4222.
+
+const char* bucket = "bench_kv_batch";
+const size_t key_count = 1024;
+const size_t value_size = 128;
+const int64_t timeout_ms = 5'000;
+
+struct Fixture
+{
+    nats::NatsClient client;
+    nats::KvStore kv;
+    vector<string> key_storage;
+    vector<string_view> keys;
+    vector<byte> value;
+    vector<span<const byte>> values;
+};
+
+expected<Fixture, nats::NatsError> setup()
+{
+    auto res0 = nats::NatsClient::create();
+    if (!res0)
+        return unexpected(res0.error());
+    nats::NatsClient& client = res0.value();
+
+    client.options().set_url("nats://localhost:4222");
+
+    auto res = client.connect();
+    if (!res)
+        return unexpected(res.error());
+
+    res = client.jet_stream();
+    if (!res)
+        return unexpected(res.error());
+
+    res = client.enable_requests(4096);
+    if (!res)
+        return unexpected(res.error());
+
+    // binds to the bucket if it already exists with the same configuration
+    auto res_kv = client.kvs_create(bucket);
+    if (!res_kv)
+        return unexpected(res_kv.error());
+
+    Fixture f{std::move(client), std::move(res_kv.value()), {}, {}, {}, {}};
+    for (size_t i = 0; i < key_count; ++i)
+        f.key_storage.push_back(std::format("key{}", i));
+    for (const string& key : f.key_storage)
+        f.keys.push_back(key);
+    f.value.resize(value_size);
+    f.values.assign(key_count, span<const byte>(f.value));
+    return f;
+}
+
+void set_counters(benchmark::State& state)
+{
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(key_count));
+}
+
+// One blocking `kv_put` per key.
+void BM_kv_put(benchmark::State& state)
+{
+    auto res_f = setup();
+    if (!res_f)
+    {
+        state.SkipWithError(res_f.error().to_string().c_str());
+        return;
+    }
+    Fixture& f = res_f.value();
+
+    for (auto _ : state)
+    {
+        for (string_view key : f.keys)
+        {
+            auto res = f.client.kv_put(f.kv, key, span<byte>(f.value));
+            if (!res)
+            {
+                state.SkipWithError(res.error().to_string().c_str());
+                return;
+            }
+        }
+    }
+
+    set_counters(state);
+}
+
+// `kv_put_many` with `state.range(0)` puts in flight.
+void BM_kv_put_many(benchmark::State& state)
+{
+    auto res_f = setup();
+    if (!res_f)
+    {
+        state.SkipWithError(res_f.error().to_string().c_str());
+        return;
+    }
+    Fixture& f = res_f.value();
+    size_t depth = static_cast<size_t>(state.range(0));
+
+    for (auto _ : state)
+    {
+        auto res = f.client.kv_put_many(f.kv, f.keys, f.values, depth, timeout_ms);
+        if (!res)
+        {
+            state.SkipWithError(res.error().to_string().c_str());
+            return;
+        }
+        for (auto& rev : res.value())
+        {
+            if (!rev)
+            {
+                state.SkipWithError(rev.error().to_string().c_str());
+                return;
+            }
+        }
+    }
+
+    set_counters(state);
+}
+
+// One blocking `kv_get` per key.
+void BM_kv_get(benchmark::State& state)
+{
+    auto res_f = setup();
+    if (!res_f)
+    {
+        state.SkipWithError(res_f.error().to_string().c_str());
+        return;
+    }
+    Fixture& f = res_f.value();
+
+    auto res_put = f.client.kv_put_many(f.kv, f.keys, f.values, 256, timeout_ms);
+    if (!res_put)
+    {
+        state.SkipWithError(res_put.error().to_string().c_str());
+        return;
+    }
+
+    for (auto _ : state)
+    {
+        for (string_view key : f.keys)
+        {
+            auto res = f.client.kv_get(f.kv, key);
+            if (!res)
+            {
+                state.SkipWithError(res.error().to_string().c_str());
+                return;
+            }
+            benchmark::DoNotOptimize(res.value().revision());
+        }
+    }
+
+    set_counters(state);
+}
+
+// `kv_get_many` with `state.range(0)` gets in flight.
+void BM_kv_get_many(benchmark::State& state)
+{
+    auto res_f = setup();
+    if (!res_f)
+    {
+        state.SkipWithError(res_f.error().to_string().c_str());
+        return;
+    }
+    Fixture& f = res_f.value();
+    size_t depth = static_cast<size_t>(state.range(0));
+
+    auto res_put = f.client.kv_put_many(f.kv, f.keys, f.values, 256, timeout_ms);
+    if (!res_put)
+    {
+        state.SkipWithError(res_put.error().to_string().c_str());
+        return;
+    }
+
+    for (auto _ : state)
+    {
+        auto res = f.client.kv_get_many(f.kv, f.keys, depth, timeout_ms);
+        if (!res)
+        {
+            state.SkipWithError(res.error().to_string().c_str());
+            return;
+        }
+        for (auto& value : res.value())
+        {
+            if (!value)
+            {
+                state.SkipWithError(value.error().to_string().c_str());
+                return;
+            }
+        }
+    }
+
+    set_counters(state);
+}
+
+BENCHMARK(BM_kv_put)->UseRealTime();
+BENCHMARK(BM_kv_put_many)->RangeMultiplier(4)->Range(1, 1024)->UseRealTime();
+BENCHMARK(BM_kv_get)->UseRealTime();
+BENCHMARK(BM_kv_get_many)->RangeMultiplier(4)->Range(1, 1024)->UseRealTime();
+
+int main(int argc, char** argv)
+{
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv))
+        return 1;
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+
+    nats_Close();
+
+    return 0;
+}
@@ -0,0 +1,172 @@
+#include <iostream>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <format>
+#include <expected>
+#include <thread>
+#include <chrono>
+#include <span>
+#include <vector>
+#include <stop_token>
+
+#include "nats_client/Client.hpp"
+
+using std::string;
+using std::expected;
+using std::unexpected;
+using std::span;
+using std::byte;
+using std::vector;
+using namespace std::chrono;
+
+// Consumer throughput of single (`next_msg`) vs. batched (`next_msgs`) retrieval
+// from a sync subscription, while a publisher saturates the subject.
+// Requires a NATS server running on localhost:4222.
+
+const char* subject = "bench_next_msgs";
+const size_t batch_size = 256;
+const seconds duration_per_mode{5};
+
+expected<nats::NatsClient, nats::NatsError> connect()
+{
+    auto res0 = nats::NatsClient::create();
+    if (!res0)
+        return unexpected(res0.error());
+    nats::NatsClient& client = res0.value();
+
+    client
+        .options() //
+        .set_url("nats://localhost:4222");
+
+    auto res = client.connect();
+    if (!res)
+        return unexpected(res.error());
+
+    return std::move(client);
+}
+
+expected<void, nats::NatsError> run_producer(std::stop_token stop)
+{
+    auto res_client = connect();
+    if (!res_client)
+        return unexpected(res_client.error());
+    nats::NatsClient& client = res_client.value();
+
+    auto res_subject = nats::NatsSubject::create(subject);
+    if (!res_subject)
+        return unexpected(res_subject.error());
+
+    int64_t counter = 0;
+    while (!stop.stop_requested())
+    {
+        auto res = client.publish(res_subject.value(), counter);
+        if (!res)
+            return unexpected(res.error());
+        ++counter;
+    }
+
+    return {}; // Success
+}
+
+template <typename F>
+expected<void, nats::NatsError> measure(nats::NatsClient& client, const char* name, F&& receive)
+{
+    auto res_sub = client.subscribe_sync(subject);
+    if (!res_sub)
+        return unexpected(res_sub.error());
+    nats::NatsSubscriptionSync& sub = res_sub.value();
+
+    // keep the publisher from turning this into a slow consumer benchmark
+    auto res_limits = sub.set_pending_limits(10'000'000, 1024 * 1024 * 1024);
+    if (!res_limits)
+        return unexpected(res_limits.error());
+
+    int64_t received = 0;
+    auto start = steady_clock::now();
+    while (steady_clock::now() - start < duration_per_mode)
+    {
+        auto res = receive(sub);
+        if (!res)
+        {
+            if (res.error().status == NATS_SLOW_CONSUMER)
+                continue;
+            return unexpected(res.error());
+        }
+        received += res.value();
+    }
+    auto elapsed = duration_cast<duration<double>>(steady_clock::now() - start).count();
+
+    auto res_dropped = sub.get_dropped();
+    if (!res_dropped)
+        return unexpected(res_dropped.error());
+
+    std::cout << std::format(
+        "{:<10} {:>12.0f} msgs/s ({} dropped)\n",
+        name,
+        static_cast<double>(received) / elapsed,
+        res_dropped.value()
+    );
+    return {}; // Success
+}
+
+expected<void, nats::NatsError> run_consumer()
+{
+    auto res_client = connect();
+    if (!res_client)
+        return unexpected(res_client.error());
+    nats::NatsClient& client = res_client.value();
+
+    auto res1 = measure(
+        client,
+        "next_msg",
+        [](nats::NatsSubscriptionSync& sub) -> expected<size_t, nats::NatsError>
+        {
+            auto res = sub.try_next_msg(100);
+            if (!res)
+                return unexpected(res.error());
+            return res.value().has_value() ? 1 : 0;
+        }
+    );
+    if (!res1)
+        return res1;
+
+    vector<nats::NatsMessageView> msgs(batch_size);
+    auto res2 = measure(
+        client,
+        "next_msgs",
+        [&](nats::NatsSubscriptionSync& sub) { return sub.next_msgs(msgs, 100); }
+    );
+    if (!res2)
+        return res2;
+
+    return {}; // Success
+}
+
+int main()
+{
+    // run producer in thread until consumer is done
+    std::jthread producer_thread(
+        [](std::stop_token stop)
+        {
+            auto ret = run_producer(stop);
+            if (!ret)
+            {
+                std::cerr << ret.error().to_string() << std::endl;
+            }
+        }
+    );
+
+    auto ret = run_consumer();
+    if (!ret)
+    {
+        std::cerr << ret.error().to_string() << std::endl;
+    }
+
+    producer_thread.request_stop();
+    producer_thread.join();
+
+    nats_Close();
+
+    return ret ? 0 : 1;
+}
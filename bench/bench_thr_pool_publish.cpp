@@ -0,0 +1,142 @@
+#include <iostream>
+#include <cstddef>
+#include <cstdint>
+#include <atomic>
+#include <string>
+#include <format>
+#include <expected>
+#include <thread>
+#include <chrono>
+#include <span>
+#include <vector>
+
+#include "nats_client/ClientPool.hpp"
+
+using std::string;
+using std::expected;
+using std::unexpected;
+using std::span;
+using std::byte;
+using std::vector;
+using namespace std::chrono;
+
+// Aggregate publish throughput of a `NatsClientPool` with 1 to 16 connections.
+// A fixed number of publisher threads each publish round robin to their own set of subjects,
+// which the pool spreads over its connections. Nobody subscribes, so the server discards
+// the messages and the client side is measured.
+// Requires a NATS server running on localhost:4222.
+
+const size_t publishers = 16;
+const size_t subjects_per_publisher = 64;
+const size_t payload_size = 128;
+const int64_t flush_timeout_ms = 10'000;
+const seconds duration_per_run{5};
+const size_t connection_counts[] = {1, 2, 4, 8, 16};
+
+expected<void, nats::NatsError> run(size_t connections)
+{
+    auto res_pool = nats::NatsClientPool::create(
+        connections,
+        [](nats::NatsClient& client, size_t i)
+        {
+            client
+                .options() //
+                .set_url("nats://localhost:4222")
+                .set_name(std::format("bench_pool_{}", i));
+        }
+    );
+    if (!res_pool)
+        return unexpected(res_pool.error());
+    nats::NatsClientPool& pool = res_pool.value();
+
+    auto res = pool.connect();
+    if (!res)
+        return unexpected(res.error());
+
+    vector<vector<nats::NatsSubject>> subjects(publishers);
+    for (size_t p = 0; p < publishers; ++p)
+    {
+        for (size_t i = 0; i < subjects_per_publisher; ++i)
+        {
+            auto res_subject = nats::NatsSubject::create(std::format("bench_pool.{}.{}", p, i));
+            if (!res_subject)
+                return unexpected(res_subject.error());
+            subjects[p].push_back(std::move(res_subject.value()));
+        }
+    }
+
+    std::atomic<bool> stop{false};
+    std::atomic<bool> failed{false};
+    vector<int64_t> published(publishers, 0);
+    {
+        vector<std::jthread> threads;
+        for (size_t p = 0; p < publishers; ++p)
+        {
+            threads.emplace_back(
+                [&, p]()
+                {
+                    vector<byte> payload(payload_size);
+                    int64_t n = 0;
+                    while (!stop.load(std::memory_order_relaxed))
+                    {
+                        const nats::NatsSubject& subject = subjects[p][n % subjects_per_publisher];
+                        if (!pool.publish(subject, span<const byte>(payload)))
+                        {
+                            failed.store(true);
+                            break;
+                        }
+                        ++n;
+                    }
+                    published[p] = n;
+                }
+            );
+        }
+        std::this_thread::sleep_for(duration_per_run);
+        stop.store(true);
+    }
+
+    res = pool.flush(flush_timeout_ms);
+    if (!res)
+        return unexpected(res.error());
+    if (failed.load())
+        return unexpected(nats::NatsError(NATS_ERR, "Publishing failed."));
+
+    auto res_stats = pool.stats();
+    if (!res_stats)
+        return unexpected(res_stats.error());
+
+    int64_t total = 0;
+    for (int64_t n : published)
+        total += n;
+    double elapsed = duration_cast<duration<double>>(duration_per_run).count();
+
+    std::cout << std::format(
+        "{:>2} connections {:>12.0f} msgs/s {:>8.1f} MB/s ({} msgs sent)\n",
+        connections,
+        static_cast<double>(total) / elapsed,
+        static_cast<double>(res_stats.value().out_bytes) / elapsed / 1e6,
+        res_stats.value().out_msgs
+    );
+    return {}; // Success
+}
+
+int main()
+{
+    expected<void, nats::NatsError> ret;
+    for (size_t connections : connection_counts)
+    {
+        ret = run(connections);
+        if (!ret)
+            break;
+    }
+
+    nats_Close();
+
+    if (!ret)
+    {
+        std::cerr << ret.error().to_string() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
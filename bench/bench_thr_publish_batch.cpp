@@ -0,0 +1,158 @@
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <expected>
+#include <vector>
+#include <span>
+#include <benchmark/benchmark.h>
+
+#include "nats_client/Client.hpp"
+
+using std::string;
+using std::expected;
+using std::unexpected;
+using std::vector;
+using std::span;
+using std::byte;
+
+// Publish throughput of single vs. batched publishing for various payload sizes.
+// Requires a NATS server running on localhost:4222.
+
+const char* subject = "bench_publish_batch";
+const int batch_size = 128;
+const int64_t flush_timeout_ms = 10'000;
+
+expected<nats::NatsClient, nats::NatsError> connect(bool send_asap)
+{
+    auto res0 = nats::NatsClient::create();
+    if (!res0)
+        return unexpected(res0.error());
+    nats::NatsClient& client = res0.value();
+
+    client
+        .options()                        //
+        .set_url("nats://localhost:4222") //
+        .set_send_asap(send_asap);
+
+    auto res = client.connect();
+    if (!res)
+        return unexpected(res.error());
+
+    return std::move(client);
+}
+
+void set_counters(benchmark::State& state, size_t payload_size)
+{
+    int64_t msgs = state.iterations() * batch_size;
+    state.SetItemsProcessed(msgs);
+    state.SetBytesProcessed(msgs * static_cast<int64_t>(payload_size));
+}
+
+// One `publish` call per message, each written to the socket immediately.
+void BM_publish_unbatched(benchmark::State& state)
+{
+    auto res_client = connect(true);
+    if (!res_client)
+    {
+        state.SkipWithError(res_client.error().to_string().c_str());
+        return;
+    }
+    nats::NatsClient& client = res_client.value();
+
+    vector<byte> payload(static_cast<size_t>(state.range(0)));
+
+    for (auto _ : state)
+    {
+        for (int i = 0; i < batch_size; ++i)
+        {
+            auto res = client.publish(subject, span<const byte>(payload));
+            if (!res)
+            {
+                state.SkipWithError(res.error().to_string().c_str());
+                return;
+            }
+        }
+    }
+
+    set_counters(state, payload.size());
+}
+
+// `publish_batch` with a single flush (PING/PONG round trip) per batch.
+void BM_publish_batch_flush(benchmark::State& state)
+{
+    auto res_client = connect(false);
+    if (!res_client)
+    {
+        state.SkipWithError(res_client.error().to_string().c_str());
+        return;
+    }
+    nats::NatsClient& client = res_client.value();
+
+    vector<byte> payload(static_cast<size_t>(state.range(0)));
+    nats::PublishBatch batch(batch_size);
+    for (int i = 0; i < batch_size; ++i)
+        batch.add(subject, span<const byte>(payload));
+
+    for (auto _ : state)
+    {
+        auto res = client.publish_batch(batch, flush_timeout_ms);
+        if (!res)
+        {
+            state.SkipWithError(res.error().to_string().c_str());
+            return;
+        }
+    }
+
+    set_counters(state, payload.size());
+}
+
+// `publish_coalesced`, the flusher thread writes the buffered messages together.
+void BM_publish_batch_coalesced(benchmark::State& state)
+{
+    auto res_client = connect(false);
+    if (!res_client)
+    {
+        state.SkipWithError(res_client.error().to_string().c_str());
+        return;
+    }
+    nats::NatsClient& client = res_client.value();
+
+    vector<byte> payload(static_cast<size_t>(state.range(0)));
+    nats::PublishBatch batch(batch_size);
+    for (int i = 0; i < batch_size; ++i)
+        batch.add(subject, span<const byte>(payload));
+
+    for (auto _ : state)
+    {
+        auto res = client.publish_coalesced(batch);
+        if (!res)
+        {
+            state.SkipWithError(res.error().to_string().c_str());
+            return;
+        }
+    }
+
+    // don't leave buffered messages to the next benchmark (not timed)
+    auto res = client.flush(flush_timeout_ms);
+    if (!res)
+        state.SkipWithError(res.error().to_string().c_str());
+
+    set_counters(state, payload.size());
+}
+
+BENCHMARK(BM_publish_unbatched)->RangeMultiplier(8)->Range(8, 64 << 10);
+BENCHMARK(BM_publish_batch_flush)->RangeMultiplier(8)->Range(8, 64 << 10);
+BENCHMARK(BM_publish_batch_coalesced)->RangeMultiplier(8)->Range(8, 64 << 10);
+
+int main(int argc, char** argv)
+{
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv))
+        return 1;
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+
+    nats_Close();
+
+    return 0;
+}
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <array>
+#include <bit>
+#include <limits>
+#include <algorithm>
+
+// HDR-style log-bucketed histogram for latencies in nanoseconds.
+//
+// Values are grouped by their power of two, each power of two is split into
+// `sub_bucket_half` linear sub-buckets. Values below `sub_bucket_count` are exact,
+// larger values are recorded with a relative error below 1/`sub_bucket_half` (~1.6%).
+// Recording is a couple of bit operations and an increment, no allocations.
+class LatencyHistogram
+{
+public:
+    static constexpr int sub_bucket_bits = 7;
+    static constexpr int64_t sub_bucket_count = int64_t{1} << sub_bucket_bits;
+    static constexpr int64_t sub_bucket_half = sub_bucket_count / 2;
+    static constexpr size_t index_count = (64 - sub_bucket_bits + 1) * sub_bucket_half;
+
+private:
+    std::array<uint64_t, index_count> counts{};
+    uint64_t total = 0;
+    int64_t min_value = std::numeric_limits<int64_t>::max();
+    int64_t max_value = 0;
+    double sum = 0;
+
+    static size_t index_of(int64_t value) noexcept
+    {
+        uint64_t v = static_cast<uint64_t>(value);
+        int shift = std::max(0, static_cast<int>(std::bit_width(v)) - sub_bucket_bits);
+        return static_cast<size_t>(shift * sub_bucket_half + static_cast<int64_t>(v >> shift));
+    }
+
+    // highest value that maps to the same index
+    static int64_t value_of(size_t index) noexcept
+    {
+        int64_t i = static_cast<int64_t>(index);
+        int shift = i < sub_bucket_count ? 0 : static_cast<int>(i / sub_bucket_half - 1);
+        int64_t lowest = (i - shift * sub_bucket_half) << shift;
+        return lowest + (int64_t{1} << shift) - 1;
+    }
+
+public:
+    /**
+     * Records a value, negative values are clamped to 0.
+     */
+    void record(int64_t value) noexcept
+    {
+        value = std::max<int64_t>(value, 0);
+        ++counts[index_of(value)];
+        ++total;
+        sum += static_cast<double>(value);
+        min_value = std::min(min_value, value);
+        max_value = std::max(max_value, value);
+    }
+
+    /**
+     * Adds all values recorded in `other`.
+     */
+    void merge(const LatencyHistogram& other) noexcept
+    {
+        for (size_t i = 0; i < index_count; ++i)
+            counts[i] += other.counts[i];
+        total += other.total;
+        sum += other.sum;
+        min_value = std::min(min_value, other.min_value);
+        max_value = std::max(max_value, other.max_value);
+    }
+
+    void reset() noexcept
+    {
+        *this = LatencyHistogram();
+    }
+
+    uint64_t count() const noexcept
+    {
+        return total;
+    }
+
+    int64_t min() const noexcept
+    {
+        return total ? min_value : 0;
+    }
+
+    int64_t max() const noexcept
+    {
+        return max_value;
+    }
+
+    double mean() const noexcept
+    {
+        return total ? sum / static_cast<double>(total) : 0.0;
+    }
+
+    /**
+     * Returns the value at the given percentile (0-100).
+     */
+    int64_t percentile(double p) const noexcept
+    {
+        if (total == 0)
+            return 0;
+        if (p >= 100.0)
+            return max_value;
+
+        auto rank = static_cast<uint64_t>(p / 100.0 * static_cast<double>(total) + 0.5);
+        rank = std::clamp<uint64_t>(rank, 1, total);
+
+        uint64_t seen = 0;
+        for (size_t i = 0; i < index_count; ++i)
+        {
+            seen += counts[i];
+            if (seen >= rank)
+                return std::min(value_of(i), max_value);
+        }
+        return max_value;
+    }
+};
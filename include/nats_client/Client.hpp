@@ -2,19 +2,42 @@
 
 #include <cstdint>
 #include <cstddef>
+#include <cstring>
 #include <string>
 #include <string_view>
-#include <iostream>
+#include <chrono>
 #include <span>
 #include <expected>
 #include <vector>
 #include <format>
+#include <memory>
+#include <new>
+#include <utility>
+#include <type_traits>
+#include <concepts>
+#include <algorithm>
+#include <optional>
 
 #include <nats/nats.h>
 #include "Options.hpp"
 #include "Error.hpp"
 #include "Kv.hpp"
+#include "KvCache.hpp"
+#include "KvBatch.hpp"
+#include "Coroutine.hpp"
+#include "EventLoop.hpp"
+#include "Events.hpp"
+#include "JetStream.hpp"
+#include "CoKvWatcher.hpp"
+#include "CoSubscription.hpp"
+#include "MessageBuilder.hpp"
+#include "PublishBatch.hpp"
+#include "PullSubscription.hpp"
+#include "RequestMux.hpp"
+#include "Stats.hpp"
+#include "Subject.hpp"
 #include "SubscriptionSync.hpp"
+#include "SubscriptionAsync.hpp"
 
 // KV store API: https://docs.nats.io/using-nats/developer/develop_jetstream/kv
 
@@ -36,15 +59,31 @@ private:
     jsCtx* js = NULL;
     natsStatus s;
     jsOptions jsOpts;
+    // heap allocated, its address is the ack callback closure
+    std::unique_ptr<JsAckHandler> js_ack_handler;
+    std::unique_ptr<NatsRequestMux> requests;
+    natsStatistics* stats_scratch = nullptr;
+    // passed as closure to the cnats callbacks, must outlive the connection
+    NatsEventSink* event_sink = nullptr;
 
     void cleanup()
     {
+        // stops the inbox subscription before the connection goes away
+        requests.reset();
+
         if (conn)
         {
+            NatsMetricsRegistry::instance().remove(conn);
             natsConnection_Destroy(conn);
             conn = nullptr;
         }
 
+        if (stats_scratch)
+        {
+            natsStatistics_Destroy(stats_scratch);
+            stats_scratch = nullptr;
+        }
+
         opts.~NatsOptions();
 
         if (js)
@@ -52,6 +91,7 @@ private:
             jsCtx_Destroy(js);
             js = NULL;
         }
+        js_ack_handler.reset();
         // nats_Close(); // there could be other clients
     }
 
@@ -83,9 +123,19 @@ public:
     NatsClient& operator=(const NatsClient&) = delete;
 
     // Allow moving
-    NatsClient(NatsClient&& other) noexcept : conn(other.conn), opts(std::move(other.opts))
+    NatsClient(NatsClient&& other) noexcept
+        : conn(other.conn),
+          opts(std::move(other.opts)),
+          js(other.js),
+          jsOpts(other.jsOpts),
+          js_ack_handler(std::move(other.js_ack_handler)),
+          requests(std::move(other.requests)),
+          stats_scratch(other.stats_scratch),
+          event_sink(other.event_sink)
     {
         other.conn = nullptr;
+        other.js = NULL;
+        other.stats_scratch = nullptr;
     }
     NatsClient& operator=(NatsClient&& other) noexcept
     {
@@ -94,7 +144,15 @@ public:
             cleanup();
             conn = other.conn;
             opts = std::move(other.opts);
+            js = other.js;
+            jsOpts = other.jsOpts;
+            js_ack_handler = std::move(other.js_ack_handler);
+            requests = std::move(other.requests);
+            stats_scratch = other.stats_scratch;
+            event_sink = other.event_sink;
             other.conn = nullptr;
+            other.js = NULL;
+            other.stats_scratch = nullptr;
             other.opts = nullptr;
         }
         return *this;
@@ -122,6 +180,19 @@ public:
         return opts;
     }
 
+    /**
+     * Sets the sink receiving asynchronous errors and connection state changes.
+     *
+     * Must be called before `connect`, the sink must outlive the client. By default,
+     * events go to `NatsAsyncEventSink::instance()`, which prints them to `std::cerr`
+     * from a background thread.
+     */
+    NatsClient& set_event_sink(NatsEventSink& sink) noexcept
+    {
+        event_sink = &sink;
+        return *this;
+    }
+
     /**
      * Connect to NATS server.
      * To enable JetStream, call `jet_stream()` after connecting.
@@ -131,40 +202,69 @@ public:
         if (opts.s != NATS_OK)
             return unexpected(NatsError(opts.s, "NATS options has an error."));
 
+        if (!event_sink)
+            event_sink = &NatsAsyncEventSink::instance();
+
         // Set disconnected callback
-        if ((s = natsOptions_SetDisconnectedCB(opts.ptr, disconnected_callback, NULL)) != NATS_OK)
+        if ((s = natsOptions_SetDisconnectedCB(opts.ptr, disconnected_callback, event_sink)) !=
+            NATS_OK)
             return unexpected(NatsError(s, "Error setting disconnected callback."));
 
         // Set reconnected callback
-        if ((s = natsOptions_SetReconnectedCB(opts.ptr, reconnected_callback, NULL)) != NATS_OK)
+        if ((s = natsOptions_SetReconnectedCB(opts.ptr, reconnected_callback, event_sink)) !=
+            NATS_OK)
             return unexpected(NatsError(s, "Error setting reconnected callback."));
 
         // Set closed callback
-        if ((s = natsOptions_SetClosedCB(opts.ptr, closed_callback, NULL)) != NATS_OK)
+        if ((s = natsOptions_SetClosedCB(opts.ptr, closed_callback, event_sink)) != NATS_OK)
             return unexpected(NatsError(s, "Error setting closed callback."));
 
         // Set error handler
-        if ((s = natsOptions_SetErrorHandler(opts.ptr, error_handler_callback, nullptr)) != NATS_OK)
+        if ((s = natsOptions_SetErrorHandler(opts.ptr, error_handler_callback, event_sink)) !=
+            NATS_OK)
             return unexpected(NatsError(s, "Error setting error handler callback."));
 
         // Connect
         if ((s = natsConnection_Connect(&conn, opts.ptr)) != NATS_OK)
             return unexpected(NatsError(s, "Connect failed. Check NATS server is running."));
 
+        NatsMetricsRegistry::instance().add(conn, opts.name);
+
         return {}; // Success
     }
 
+    /**
+     * Returns message and byte counts in both directions and the number of reconnects,
+     * read with a single lock acquisition.
+     */
+    expected<NatsConnectionStats, NatsError> stats() noexcept
+    {
+        if (!stats_scratch && (s = natsStatistics_Create(&stats_scratch)) != NATS_OK)
+            return unexpected(NatsError(s, "Failed to create statistics object."));
+        return NatsConnectionStats::read(conn, stats_scratch);
+    }
+
     /**
      * Enable JetStream for the connection.
+     *
+     * `config.max_pending` is the in-flight window of `js_publish_async`: the larger the window,
+     * the more publishes are pipelined per ack round trip, at the cost of memory for the
+     * messages awaiting their ack.
      */
-    expected<void, NatsError> jet_stream() noexcept
+    expected<void, NatsError> jet_stream(JsConfig config = {}) noexcept
     {
         // Initialize and set some JetStream options
         if ((s = jsOptions_Init(&jsOpts)) != NATS_OK)
             return unexpected(NatsError(s, "Failed to initialize JetStream options."));
 
-        // Set some options TODO
-        jsOpts.PublishAsync.MaxPending = 256;
+        jsOpts.PublishAsync.MaxPending = config.max_pending;
+        jsOpts.PublishAsync.StallWait = config.stall_wait_ms;
+        if (config.ack_handler)
+        {
+            js_ack_handler = std::make_unique<JsAckHandler>(std::move(config.ack_handler));
+            jsOpts.PublishAsync.AckHandler = js_ack_callback;
+            jsOpts.PublishAsync.AckHandlerClosure = js_ack_handler.get();
+        }
 
         // Create JetStream Context
         if ((s = natsConnection_JetStream(&js, conn, &jsOpts)) != NATS_OK)
@@ -173,6 +273,141 @@ public:
         return {}; // Success
     }
 
+    /**
+     * Publishes a message to a stream and waits for its acknowledgement.
+     *
+     * `timeout_ms` of 0 uses the default wait of the JetStream context.
+     * Requires `jet_stream` to be called first.
+     */
+    expected<JsPubAck, NatsError> js_publish(
+        string_view subject, span<const byte> data, int64_t timeout_ms = 0
+    ) noexcept
+    {
+        if (!js)
+            return unexpected(NatsError(NATS_ILLEGAL_STATE, "JetStream is not enabled."));
+
+        jsPubOptions pub_opts;
+        jsPubOptions* pub_opts_ptr = NULL;
+        if (timeout_ms > 0)
+        {
+            jsPubOptions_Init(&pub_opts);
+            pub_opts.MaxWait = timeout_ms;
+            pub_opts_ptr = &pub_opts;
+        }
+
+        jsPubAck* pa = NULL;
+        jsErrCode err_code = static_cast<jsErrCode>(0);
+        int size = static_cast<int>(data.size());
+        s = js_Publish(&pa, js, subject.data(), data.data(), size, pub_opts_ptr, &err_code);
+        if (s != NATS_OK)
+        {
+            return unexpected(NatsError(
+                s,
+                std::format(
+                    "Failed to publish {} bytes to stream subject [{}], error code {}.",
+                    data.size(),
+                    subject,
+                    static_cast<int>(err_code)
+                )
+            ));
+        }
+        return JsPubAck(pa);
+    }
+
+    expected<JsPubAck, NatsError> js_publish(
+        string_view subject, string_view data, int64_t timeout_ms = 0
+    ) noexcept
+    {
+        span<const byte> bytes{reinterpret_cast<const byte*>(data.data()), data.size()};
+        return js_publish(subject, bytes, timeout_ms);
+    }
+
+    /**
+     * Publishes a message to a stream without waiting for its acknowledgement.
+     *
+     * Up to `JsConfig::max_pending` messages are in flight, beyond that the call blocks until
+     * acks free up the window, or fails with `NATS_TIMEOUT` after `JsConfig::stall_wait_ms`.
+     * Acks are reported to `JsConfig::ack_handler`, use `js_publish_async_complete`
+     * to wait for all of them.
+     */
+    expected<void, NatsError> js_publish_async(string_view subject, span<const byte> data) noexcept
+    {
+        if (!js)
+            return unexpected(NatsError(NATS_ILLEGAL_STATE, "JetStream is not enabled."));
+
+        s = js_PublishAsync(js, subject.data(), data.data(), static_cast<int>(data.size()), NULL);
+        if (s != NATS_OK)
+        {
+            if (s == NATS_TIMEOUT)
+                return unexpected(NatsError(s));
+            return unexpected(NatsError(
+                s,
+                std::format(
+                    "Failed to async publish {} bytes to stream subject [{}].", data.size(), subject
+                )
+            ));
+        }
+        return {}; // Success
+    }
+
+    expected<void, NatsError> js_publish_async(string_view subject, string_view data) noexcept
+    {
+        span<const byte> bytes{reinterpret_cast<const byte*>(data.data()), data.size()};
+        return js_publish_async(subject, bytes);
+    }
+
+    /**
+     * Waits until all messages published with `js_publish_async` are acknowledged,
+     * fails with status-only `NATS_TIMEOUT` if some are still pending after `timeout_ms`.
+     */
+    expected<void, NatsError> js_publish_async_complete(int64_t timeout_ms) noexcept
+    {
+        if (!js)
+            return unexpected(NatsError(NATS_ILLEGAL_STATE, "JetStream is not enabled."));
+
+        jsPubOptions pub_opts;
+        jsPubOptions_Init(&pub_opts);
+        pub_opts.MaxWait = timeout_ms;
+        if ((s = js_PublishAsyncComplete(js, &pub_opts)) != NATS_OK)
+        {
+            if (s == NATS_TIMEOUT)
+                return unexpected(NatsError(s));
+            return unexpected(NatsError(s, "Failed to wait for async publish completion."));
+        }
+        return {}; // Success
+    }
+
+    /**
+     * Creates a pull subscription on the durable consumer `durable` of the stream
+     * capturing `subject`. The consumer is created with default settings if it does not exist.
+     *
+     * Requires `jet_stream` to be called first.
+     */
+    expected<JsPullSubscription, NatsError> js_pull_subscribe(
+        string_view subject, string_view durable
+    ) noexcept
+    {
+        if (!js)
+            return unexpected(NatsError(NATS_ILLEGAL_STATE, "JetStream is not enabled."));
+
+        natsSubscription* sub = NULL;
+        jsErrCode err_code = static_cast<jsErrCode>(0);
+        s = js_PullSubscribe(&sub, js, subject.data(), durable.data(), NULL, NULL, &err_code);
+        if (s != NATS_OK)
+        {
+            return unexpected(NatsError(
+                s,
+                std::format(
+                    "Failed to pull subscribe to subject [{}] with durable [{}], error code {}.",
+                    subject,
+                    durable,
+                    static_cast<int>(err_code)
+                )
+            ));
+        }
+        return JsPullSubscription(sub);
+    }
+
     /**
      * Returns the maximum payload size that can be sent to the server.
      */
@@ -259,6 +494,44 @@ public:
         return list;
     }
 
+    /**
+     * Calls `on_key` with each key in the bucket, streamed from a watcher one entry at a time,
+     * so the whole list is never resident. The key is only valid during the call.
+     *
+     * `timeout_ms` bounds the wait for each key.
+     */
+    template <std::invocable<string_view> OnKey>
+    expected<void, NatsError> kvs_keys_each(
+        KvStore& kv_store, OnKey&& on_key, int64_t timeout_ms
+    ) noexcept
+    {
+        kvWatchOptions o;
+        if ((s = kvWatchOptions_Init(&o)) != NATS_OK)
+            return unexpected(NatsError(s, "Failed to initialize KV watcher options."));
+        // same options as kvStore_Keys: no values, no deleted keys
+        o.IgnoreDeletes = true;
+        o.MetaOnly = true;
+
+        kvWatcher* w = NULL;
+        if ((s = kvStore_WatchAll(&w, kv_store.ptr, &o)) != NATS_OK)
+        {
+            return unexpected(NatsError(
+                s, std::format("Failed to list keys of KV bucket [{}].", kv_store.bucket())
+            ));
+        }
+        KvWatcher watcher(w);
+
+        while (true)
+        {
+            auto res = watcher.next(timeout_ms);
+            if (!res)
+                return unexpected(res.error());
+            if (!res.value())
+                return {}; // Success, all keys seen
+            on_key(res.value()->key());
+        }
+    }
+
     /**
      * Initializes a KeyValue watcher options structure.
      *
@@ -296,6 +569,21 @@ public:
         return KvWatcher(w);
     }
 
+    /**
+     * Returns a local cache of the keys matching `keys` (which could include wildcard),
+     * loaded from a watcher and kept up to date by it, see `KvCache`.
+     * `timeout_ms` bounds the wait for each entry of the initial state.
+     */
+    expected<KvCache, NatsError> kvs_cache(
+        KvStore& kv_store, string_view keys, int64_t timeout_ms
+    ) noexcept
+    {
+        auto res = kvs_watch(kv_store, keys, nullptr);
+        if (!res)
+            return unexpected(res.error());
+        return KvCache::create(std::move(res.value()), timeout_ms);
+    }
+
     /**
      * Returns the latest entry for the key.
      */
@@ -316,14 +604,15 @@ public:
 
     /**
      * Places the value for the key into the store if and only if the key does not exist.
+     * Returns the revision of the new entry.
      */
-    expected<void, NatsError> kv_create(
+    expected<uint64_t, NatsError> kv_create(
         KvStore& kv_store, string_view key, span<byte> data
     ) noexcept
     {
-        uint64_t* rev = NULL;
+        uint64_t rev = 0;
         size_t size = data.size_bytes();
-        if ((s = kvStore_Create(rev, kv_store.ptr, key.data(), data.data(), size)) != NATS_OK)
+        if ((s = kvStore_Create(&rev, kv_store.ptr, key.data(), data.data(), size)) != NATS_OK)
         {
             return unexpected(NatsError(
                 s,
@@ -335,18 +624,19 @@ public:
                 )
             ));
         }
-        return {}; // Success
+        return rev;
     }
 
     /**
      * Places the value (as a string) for the key into the store if and only if the key does not exist.
+     * Returns the revision of the new entry.
      */
-    expected<void, NatsError> kv_create_string(
+    expected<uint64_t, NatsError> kv_create_string(
         KvStore& kv_store, string_view key, string_view data
     ) noexcept
     {
-        uint64_t* rev = NULL;
-        if ((s = kvStore_CreateString(rev, kv_store.ptr, key.data(), data.data())) != NATS_OK)
+        uint64_t rev = 0;
+        if ((s = kvStore_CreateString(&rev, kv_store.ptr, key.data(), data.data())) != NATS_OK)
         {
             return unexpected(NatsError(
                 s,
@@ -357,17 +647,19 @@ public:
                 )
             ));
         }
-        return {}; // Success
+        return rev;
     }
 
     /**
      * Places the new value (as a string) for the key into the store.
+     * Returns the revision of the new entry.
      */
-    expected<void, NatsError> kv_put_string(
+    expected<uint64_t, NatsError> kv_put_string(
         KvStore& kv_store, string_view key, string_view value
     ) noexcept
     {
-        if ((s = kvStore_PutString(NULL, kv_store.ptr, key.data(), value.data())) != NATS_OK)
+        uint64_t rev = 0;
+        if ((s = kvStore_PutString(&rev, kv_store.ptr, key.data(), value.data())) != NATS_OK)
         {
             return unexpected(NatsError(
                 s,
@@ -379,16 +671,20 @@ public:
                 )
             ));
         }
-        return {}; // Success
+        return rev;
     }
 
     /**
      * Places the new value for the key into the store.
+     * Returns the revision of the new entry.
      */
-    expected<void, NatsError> kv_put(KvStore& kv_store, string_view key, span<byte> data) noexcept
+    expected<uint64_t, NatsError> kv_put(
+        KvStore& kv_store, string_view key, span<byte> data
+    ) noexcept
     {
-        if ((s = kvStore_Put(NULL, kv_store.ptr, key.data(), data.data(), data.size_bytes())) !=
-            NATS_OK)
+        uint64_t rev = 0;
+        size_t size = data.size_bytes();
+        if ((s = kvStore_Put(&rev, kv_store.ptr, key.data(), data.data(), size)) != NATS_OK)
         {
             return unexpected(NatsError(
                 s,
@@ -400,7 +696,113 @@ public:
                 )
             ));
         }
-        return {}; // Success
+        return rev;
+    }
+
+    /**
+     * Places the new value for the key into the store if and only if the latest revision
+     * of the key is `last_revision`. Returns the revision of the new entry.
+     *
+     * If the key was modified in between, fails with `NATS_ERR`. The server gives no
+     * distinct status for that case, `kv_compare_and_swap` tells it apart by reading the key.
+     */
+    expected<uint64_t, NatsError> kv_update(
+        KvStore& kv_store, string_view key, span<const byte> data, uint64_t last_revision
+    ) noexcept
+    {
+        uint64_t rev = 0;
+        int size = static_cast<int>(data.size_bytes());
+        s = kvStore_Update(&rev, kv_store.ptr, key.data(), data.data(), size, last_revision);
+        if (s != NATS_OK)
+        {
+            return unexpected(NatsError(
+                s,
+                std::format(
+                    "Failed to update KV key [{}] at revision {} in bucket [{}].",
+                    key,
+                    last_revision,
+                    kv_store.bucket()
+                )
+            ));
+        }
+        return rev;
+    }
+
+    /**
+     * Places the new value (as a string) for the key into the store if and only if the latest
+     * revision of the key is `last_revision`. Returns the revision of the new entry.
+     */
+    expected<uint64_t, NatsError> kv_update_string(
+        KvStore& kv_store, string_view key, string_view value, uint64_t last_revision
+    ) noexcept
+    {
+        span<const byte> bytes{reinterpret_cast<const byte*>(value.data()), value.size()};
+        return kv_update(kv_store, key, bytes, last_revision);
+    }
+
+    /**
+     * Read-modify-write of a key with optimistic concurrency.
+     *
+     * `modify(current, next)` receives the current value (`std::nullopt` if the key does not
+     * exist) and writes the new value into `next`, which is reused across attempts. The write
+     * is made with `kv_update` (or `kv_create` for a missing key); if another writer got in
+     * between, `modify` is called again with its value, at most `max_attempts` times.
+     * Returns the revision of the written entry.
+     *
+     * Each attempt takes one read and one write round trip. A write failing with `NATS_ERR`
+     * counts as a conflict if reading the key again shows a different revision (or the key
+     * appeared or disappeared), otherwise its error is returned.
+     */
+    template <typename Modify>
+        requires std::invocable<Modify&, optional<span<const byte>>, vector<byte>&>
+    expected<uint64_t, NatsError> kv_compare_and_swap(
+        KvStore& kv_store, string_view key, Modify&& modify, int max_attempts = 8
+    ) noexcept
+    {
+        vector<byte> next;
+        auto res_get = kv_get(kv_store, key);
+        for (int attempt = 0; attempt < max_attempts; ++attempt)
+        {
+            if (!res_get && res_get.error().status != NATS_NOT_FOUND)
+                return unexpected(res_get.error());
+
+            optional<span<const byte>> current;
+            uint64_t revision = 0;
+            if (res_get)
+            {
+                current = res_get.value().value_bytes();
+                revision = res_get.value().revision();
+            }
+
+            next.clear();
+            modify(current, next);
+
+            expected<uint64_t, NatsError> res;
+            if (current)
+                res = kv_update(kv_store, key, next, revision);
+            else
+                res = kv_create(kv_store, key, span<byte>(next));
+            if (res || res.error().status != NATS_ERR)
+                return res;
+
+            // a conflict is reported as plain `NATS_ERR`, so it is confirmed by the key having
+            // changed since it was read; the new entry is the input of the next attempt
+            bool existed = current.has_value();
+            res_get = kv_get(kv_store, key);
+            if (!res_get && res_get.error().status != NATS_NOT_FOUND)
+                return unexpected(res_get.error());
+            if (res_get.has_value() == existed && (!existed || res_get->revision() == revision))
+                return res;
+        }
+        return unexpected(NatsError(
+            NATS_ERR,
+            std::format(
+                "KV key [{}] in bucket [{}] kept changing, gave up after {} attempts.",
+                key,
+                kv_store.bucket(),
+                max_attempts
+            )
+        ));
     }
 
     /**
@@ -418,6 +820,105 @@ public:
         return {}; // Success
     }
 
+    /**
+     * Puts `values[i]` for `keys[i]`, keeping up to `depth` puts in flight instead of waiting
+     * for each round trip. Returns the revision of each put, or its error, in input order.
+     *
+     * Requires `enable_requests`, `depth` is capped by its `max_in_flight`. Puts go to the
+     * bucket's default subject prefix, buckets in other JetStream domains are not supported.
+     * `timeout_ms` bounds the wait for each reply. An invalid key (see `kv_valid_key`) is
+     * reported as `NATS_INVALID_ARG` for its entry and not sent.
+     */
+    expected<vector<expected<uint64_t, NatsError>>, NatsError> kv_put_many(
+        KvStore& kv_store,
+        span<const string_view> keys,
+        span<const span<const byte>> values,
+        size_t depth,
+        int64_t timeout_ms
+    ) noexcept
+    {
+        if (keys.size() != values.size())
+        {
+            return unexpected(NatsError(
+                NATS_INVALID_ARG,
+                std::format("Got {} keys but {} values.", keys.size(), values.size())
+            ));
+        }
+
+        string subject = std::format("$KV.{}.", kv_store.bucket());
+        size_t prefix = subject.size();
+
+        vector<expected<uint64_t, NatsError>> results;
+        results.reserve(keys.size());
+        auto res = pipeline(
+            keys.size(),
+            depth,
+            timeout_ms,
+            [&](size_t i)
+            {
+                if (!kv_valid_key(keys[i]))
+                    return expected<NatsPendingRequest, NatsError>(invalid_kv_key(keys[i]));
+                subject.resize(prefix);
+                subject.append(keys[i]);
+                return request_async(subject, values[i]);
+            },
+            [&](expected<NatsMessageView, NatsError>&& reply)
+            {
+                if (!reply)
+                    results.push_back(unexpected(std::move(reply.error())));
+                else
+                    results.push_back(kv_parse_put_ack(reply.value()));
+            }
+        );
+        if (!res)
+            return unexpected(res.error());
+        return results;
+    }
+
+    /**
+     * Reads the latest value of each key, keeping up to `depth` reads in flight.
+     * Returns the value of each key, or its error, in input order. A missing or deleted key
+     * is reported as status-only `NATS_NOT_FOUND`.
+     *
+     * Uses JetStream direct gets, with the same requirements as `kv_put_many`. The bucket's
+     * stream must allow direct gets (`AllowDirect`), which buckets created by older servers
+     * or clients do not. Invalid keys are reported like in `kv_put_many`.
+     */
+    expected<vector<expected<KvValue, NatsError>>, NatsError> kv_get_many(
+        KvStore& kv_store, span<const string_view> keys, size_t depth, int64_t timeout_ms
+    ) noexcept
+    {
+        string_view bucket = kv_store.bucket();
+        string subject = std::format("$JS.API.DIRECT.GET.KV_{}.$KV.{}.", bucket, bucket);
+        size_t prefix = subject.size();
+
+        vector<expected<KvValue, NatsError>> results;
+        results.reserve(keys.size());
+        auto res = pipeline(
+            keys.size(),
+            depth,
+            timeout_ms,
+            [&](size_t i)
+            {
+                if (!kv_valid_key(keys[i]))
+                    return expected<NatsPendingRequest, NatsError>(invalid_kv_key(keys[i]));
+                subject.resize(prefix);
+                subject.append(keys[i]);
+                return request_async(subject, span<const byte>());
+            },
+            [&](expected<NatsMessageView, NatsError>&& reply)
+            {
+                if (!reply)
+                    results.push_back(unexpected(std::move(reply.error())));
+                else
+                    results.push_back(KvValue::from_reply(std::move(reply.value())));
+            }
+        );
+        if (!res)
+            return unexpected(res.error());
+        return results;
+    }
+
     /**
      * Creates a synchronous subcription which requires manual polling.
      */
@@ -456,6 +957,87 @@ public:
         return NatsSubscriptionSync(sub);
     }
 
+    /**
+     * Creates an asynchronous subscription which invokes `handler` for every message.
+     *
+     * The handler is called directly on the cnats delivery thread of the subscription
+     * with a `NatsMessageView&`, without type erasure or per-message allocations.
+     * The subscription unsubscribes when destroyed.
+     */
+    template <typename Handler>
+        requires NatsMessageHandler<std::decay_t<Handler>>
+    expected<NatsSubscriptionAsync<std::decay_t<Handler>>, NatsError> subscribe_async(
+        string_view subject, Handler&& handler
+    ) noexcept
+    {
+        using Subscription = NatsSubscriptionAsync<std::decay_t<Handler>>;
+        Subscription sub(std::forward<Handler>(handler));
+        if ((s = natsConnection_Subscribe(
+                 &sub.ptr, conn, subject.data(), Subscription::on_msg, sub.state
+             )) != NATS_OK ||
+            (s = sub.set_on_complete()) != NATS_OK)
+        {
+            return std::unexpected(
+                NatsError(s, std::format("Failed to subscribe to subject [{}].", subject))
+            );
+        }
+        return sub;
+    }
+
+    /**
+     * Creates an asynchronous queue subscription which invokes `handler` for every message.
+     *
+     * See `subscribe_async` for details on how the handler is invoked.
+     */
+    template <typename Handler>
+        requires NatsMessageHandler<std::decay_t<Handler>>
+    expected<NatsSubscriptionAsync<std::decay_t<Handler>>, NatsError> queue_subscribe_async(
+        string_view subject, string_view queue_group, Handler&& handler
+    ) noexcept
+    {
+        using Subscription = NatsSubscriptionAsync<std::decay_t<Handler>>;
+        Subscription sub(std::forward<Handler>(handler));
+        if ((s = natsConnection_QueueSubscribe(
+                 &sub.ptr,
+                 conn,
+                 subject.data(),
+                 queue_group.data(),
+                 Subscription::on_msg,
+                 sub.state
+             )) != NATS_OK ||
+            (s = sub.set_on_complete()) != NATS_OK)
+        {
+            return std::unexpected(NatsError(
+                s,
+                std::format(
+                    "Failed to queue subscribe to subject [{}] with group [{}].",
+                    subject,
+                    queue_group
+                )
+            ));
+        }
+        return sub;
+    }
+
+    /**
+     * Creates a subscription whose messages are awaited by a coroutine with `co_await sub.next()`.
+     *
+     * Up to `capacity` messages are buffered between the cnats delivery thread and the coroutine,
+     * which is resumed on `executor`. See `NatsCoSubscription` for details.
+     */
+    template <NatsExecutor Executor>
+    expected<NatsCoSubscription<Executor>, NatsError> co_subscribe(
+        string_view subject, Executor& executor, size_t capacity = 1024
+    ) noexcept
+    {
+        using Subscription = NatsCoSubscription<Executor>;
+        auto channel = std::make_unique<typename Subscription::Channel>(executor, capacity);
+        auto res_sub = subscribe_async(subject, typename Subscription::Pump{channel.get()});
+        if (!res_sub)
+            return unexpected(res_sub.error());
+        return Subscription(std::move(channel), std::move(res_sub.value()));
+    }
+
     expected<void, NatsError> unsubscribe(NatsSubscriptionSync& sub) noexcept
     {
         if ((s = natsSubscription_Unsubscribe(sub.ptr)) != NATS_OK)
@@ -467,6 +1049,173 @@ public:
         return {}; // Success
     }
 
+    /**
+     * Enables request/reply for the connection.
+     *
+     * Creates a single wildcard inbox subscription through which the replies of all
+     * requests are routed, and a table of `max_in_flight` (rounded up to a power of two)
+     * pre-allocated waiters. Call once after connecting, before using `request`.
+     */
+    expected<void, NatsError> enable_requests(size_t max_in_flight = 1024) noexcept
+    {
+        if (requests)
+            return unexpected(NatsError(NATS_ILLEGAL_STATE, "Requests are already enabled."));
+
+        auto res_mux = NatsRequestMux::create(max_in_flight);
+        if (!res_mux)
+            return unexpected(res_mux.error());
+        std::unique_ptr<NatsRequestMux>& mux = res_mux.value();
+
+        auto res_sub = subscribe_async(mux->wildcard(), NatsRequestMux::ReplyHandler{mux.get()});
+        if (!res_sub)
+            return unexpected(res_sub.error());
+        mux->sub.emplace(std::move(res_sub.value()));
+
+        requests = std::move(mux);
+        return {}; // Success
+    }
+
+    /**
+     * Publishes a request and returns without waiting for the reply.
+     *
+     * Many requests can be in flight at once, each waited for with `NatsPendingRequest::wait`.
+     * Requires `enable_requests` to be called first.
+     */
+    expected<NatsPendingRequest, NatsError> request_async(
+        string_view subject, span<const byte> data
+    ) noexcept
+    {
+        if (!requests)
+        {
+            return unexpected(NatsError(
+                NATS_ILLEGAL_STATE, "Requests are not enabled, call `enable_requests` first."
+            ));
+        }
+
+        auto res_token = requests->acquire();
+        if (!res_token)
+            return unexpected(res_token.error());
+        NatsPendingRequest pending(requests.get(), res_token.value());
+
+        char reply[NatsRequestMux::reply_size];
+        requests->reply_subject(pending.token, reply);
+        s = natsConnection_PublishRequest(conn, subject.data(), reply, data.data(), data.size());
+        if (s != NATS_OK)
+        {
+            return std::unexpected(NatsError(
+                s,
+                std::format(
+                    "Failed to publish request with {} bytes to subject [{}].", data.size(), subject
+                )
+            ));
+        }
+        return pending;
+    }
+
+    expected<NatsPendingRequest, NatsError> request_async(
+        string_view subject, string_view data
+    ) noexcept
+    {
+        span<const byte> bytes{reinterpret_cast<const byte*>(data.data()), data.size()};
+        return request_async(subject, bytes);
+    }
+
+    /**
+     * Publishes a request and blocks until the reply arrives or the timeout is reached.
+     *
+     * Requires `enable_requests` to be called first.
+     * A timeout is reported as status-only `NATS_TIMEOUT` error,
+     * no responders as `NATS_NO_RESPONDERS`.
+     */
+    expected<NatsMessageView, NatsError> request(
+        string_view subject, span<const byte> data, int64_t timeout_ms
+    ) noexcept
+    {
+        auto res = request_async(subject, data);
+        if (!res)
+            return unexpected(res.error());
+        return res.value().wait(timeout_ms);
+    }
+
+    expected<NatsMessageView, NatsError> request(
+        string_view subject, string_view data, int64_t timeout_ms
+    ) noexcept
+    {
+        auto res = request_async(subject, data);
+        if (!res)
+            return unexpected(res.error());
+        return res.value().wait(timeout_ms);
+    }
+
+    /**
+     * Publishes a request whose reply is awaited by a coroutine with `co_await`.
+     *
+     * The coroutine is resumed on `executor` when the reply arrives or the timeout is reached,
+     * without blocking a thread in between. Errors (including a failed publish) are reported
+     * by the awaited result. Requires `enable_requests` to be called first.
+     */
+    template <NatsExecutor Executor>
+    NatsRequestAwaitable<Executor> request(
+        string_view subject, span<const byte> data, int64_t timeout_ms, Executor& executor
+    ) noexcept
+    {
+        if (!requests)
+        {
+            return NatsRequestAwaitable<Executor>(NatsError(
+                NATS_ILLEGAL_STATE, "Requests are not enabled, call `enable_requests` first."
+            ));
+        }
+
+        auto res_token = requests->acquire();
+        if (!res_token)
+            return NatsRequestAwaitable<Executor>(std::move(res_token.error()));
+        uint64_t token = res_token.value();
+
+        char reply[NatsRequestMux::reply_size];
+        requests->reply_subject(token, reply);
+        requests->arm_deadline(token, timeout_ms);
+        s = natsConnection_PublishRequest(conn, subject.data(), reply, data.data(), data.size());
+        if (s != NATS_OK)
+        {
+            requests->cancel(token);
+            return NatsRequestAwaitable<Executor>(NatsError(
+                s,
+                std::format(
+                    "Failed to publish request with {} bytes to subject [{}].", data.size(), subject
+                )
+            ));
+        }
+        return NatsRequestAwaitable<Executor>(requests.get(), token, executor);
+    }
+
+    template <NatsExecutor Executor>
+    NatsRequestAwaitable<Executor> request(
+        string_view subject, string_view data, int64_t timeout_ms, Executor& executor
+    ) noexcept
+    {
+        span<const byte> bytes{reinterpret_cast<const byte*>(data.data()), data.size()};
+        return request(subject, bytes, timeout_ms, executor);
+    }
+
+    /**
+     * Publishes a reply to the reply subject of a received request.
+     */
+    expected<void, NatsError> respond(
+        const NatsMessageView& request, span<const byte> data
+    ) noexcept
+    {
+        const char* reply = natsMsg_GetReply(request.ptr);
+        if (reply == NULL)
+            return unexpected(NatsError(NATS_INVALID_ARG, "Message has no reply subject."));
+        if ((s = natsConnection_Publish(conn, reply, data.data(), data.size())) != NATS_OK)
+        {
+            return std::unexpected(NatsError(
+                s, std::format("Failed to publish reply with {} bytes to [{}].", data.size(), reply)
+            ));
+        }
+        return {}; // Success
+    }
+
     /**
      * Publishes a string on a subject.
      *
@@ -500,35 +1249,349 @@ public:
         return {}; // Success
     }
 
+    /**
+     * Publishes a string on a pre-validated subject.
+     */
+    expected<void, NatsError> publish(const NatsSubject& subject, string_view data) noexcept
+    {
+        if ((s = natsConnection_Publish(conn, subject.c_str(), data.data(), data.size())) !=
+            NATS_OK)
+        {
+            return std::unexpected(NatsError(
+                s,
+                std::format(
+                    "Failed to publish string with {} bytes to subject [{}].",
+                    data.size(),
+                    subject.view()
+                )
+            ));
+        }
+        return {}; // Success
+    }
+
+    /**
+     * Publishes the data argument to the given pre-validated subject.
+     *
+     * Preferred over the `string_view` overload on hot paths,
+     * since the subject has been checked and NUL-terminated once at creation.
+     */
+    expected<void, NatsError> publish(const NatsSubject& subject, span<const byte> data) noexcept
+    {
+        if ((s = natsConnection_Publish(conn, subject.c_str(), data.data(), data.size())) !=
+            NATS_OK)
+        {
+            return std::unexpected(NatsError(
+                s,
+                std::format(
+                    "Failed to publish {} bytes to subject [{}].", data.size(), subject.view()
+                )
+            ));
+        }
+        return {}; // Success
+    }
+
+    /**
+     * Largest payload of `publish_iov` gathered into the reusable per-thread buffer.
+     */
+    static constexpr size_t gather_buffer_max = size_t{1} << 20;
+
+    /**
+     * Publishes a payload made of several parts, e.g. a fixed header struct and a body
+     * living elsewhere, without concatenating them on the caller side.
+     *
+     * This is a convenience, not scatter/gather I/O: cnats takes a single contiguous payload,
+     * so the parts are copied into one buffer, which cnats then copies again into its
+     * outgoing buffer. Payloads up to `gather_buffer_max` bytes reuse a per-thread buffer,
+     * larger ones get a buffer of their own, freed after publishing. A single part is
+     * published directly. Fails with `NATS_NO_MEMORY` if the buffer cannot be allocated.
+     */
+    expected<void, NatsError> publish_iov(
+        string_view subject, span<const span<const byte>> parts
+    ) noexcept
+    {
+        return publish_gathered(subject, parts);
+    }
+
+    expected<void, NatsError> publish_iov(
+        const NatsSubject& subject, span<const span<const byte>> parts
+    ) noexcept
+    {
+        return publish_gathered(subject, parts);
+    }
+
+    /**
+     * Publishes a value encoded with `NatsCodec<T>`, e.g. a number sent as is.
+     *
+     * Types that convert to `string_view` or `span<const byte>` use those overloads instead.
+     */
+    template <NatsEncodable T>
+        requires(!std::convertible_to<const T&, string_view> &&
+                 !std::convertible_to<const T&, span<const byte>>)
+    expected<void, NatsError> publish(string_view subject, const T& value) noexcept
+    {
+        return publish(subject, span<const byte>(NatsCodec<T>::encode(value)));
+    }
+
+    template <NatsEncodable T>
+        requires(!std::convertible_to<const T&, string_view> &&
+                 !std::convertible_to<const T&, span<const byte>>)
+    expected<void, NatsError> publish(const NatsSubject& subject, const T& value) noexcept
+    {
+        return publish(subject, span<const byte>(NatsCodec<T>::encode(value)));
+    }
+
+    /**
+     * Publishes a message created by `NatsMessageBuilder::build`, including its headers.
+     */
+    expected<void, NatsError> publish(const NatsMessageView& msg) noexcept
+    {
+        if ((s = natsConnection_PublishMsg(conn, msg.ptr)) != NATS_OK)
+        {
+            return std::unexpected(NatsError(
+                s, std::format("Failed to publish message to subject [{}].", msg.subject())
+            ));
+        }
+        return {}; // Success
+    }
+
+    /**
+     * Builds and publishes the message, including its headers.
+     */
+    expected<void, NatsError> publish(const NatsMessageBuilder& builder) noexcept
+    {
+        auto res = builder.build();
+        if (!res)
+            return unexpected(res.error());
+        return publish(res.value());
+    }
+
+    /**
+     * Publishes all messages of the batch, then flushes once.
+     *
+     * The flush performs a PING/PONG round trip to the server, and returns
+     * `NATS_TIMEOUT` if the server did not respond within the timeout.
+     * On success, all messages have been processed by the server.
+     */
+    expected<void, NatsError> publish_batch(
+        span<const PublishItem> items, int64_t flush_timeout_ms
+    ) noexcept
+    {
+        auto res = publish_coalesced(items);
+        if (!res)
+            return res;
+        return flush(flush_timeout_ms);
+    }
+
+    expected<void, NatsError> publish_batch(
+        const PublishBatch& batch, int64_t flush_timeout_ms
+    ) noexcept
+    {
+        return publish_batch(batch.items(), flush_timeout_ms);
+    }
+
+    /**
+     * Publishes all messages of the batch into the outgoing buffer without flushing.
+     *
+     * Each message is still published individually, but with `set_send_asap(false)` (default)
+     * the messages are coalesced and written to the socket together by the flusher thread,
+     * or earlier if the outgoing buffer fills up.
+     */
+    expected<void, NatsError> publish_coalesced(span<const PublishItem> items) noexcept
+    {
+        for (size_t i = 0; i < items.size(); ++i)
+        {
+            const PublishItem& item = items[i];
+            const char* subject = item.subject.data();
+            if ((s = natsConnection_Publish(conn, subject, item.data.data(), item.data.size())) !=
+                NATS_OK)
+            {
+                return std::unexpected(NatsError(
+                    s,
+                    std::format(
+                        "Failed to publish message {} of {} in batch to subject [{}].",
+                        i + 1,
+                        items.size(),
+                        item.subject
+                    )
+                ));
+            }
+        }
+        return {}; // Success
+    }
+
+    expected<void, NatsError> publish_coalesced(const PublishBatch& batch) noexcept
+    {
+        return publish_coalesced(batch.items());
+    }
+
+    /**
+     * Flushes the connection by sending a PING and waiting for the PONG,
+     * or until the timeout is reached.
+     */
+    expected<void, NatsError> flush(int64_t timeout_ms) noexcept
+    {
+        if ((s = natsConnection_FlushTimeout(conn, timeout_ms)) != NATS_OK)
+        {
+            return std::unexpected(
+                NatsError(s, std::format("Failed to flush connection within {} ms.", timeout_ms))
+            );
+        }
+        return {}; // Success
+    }
+
 private:
+    static void emit(void* closure, NatsEvent event) noexcept
+    {
+        event.timestamp_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                 std::chrono::steady_clock::now().time_since_epoch()
+        )
+                                 .count();
+        static_cast<NatsEventSink*>(closure)->on_event(event);
+    }
+
     static void error_handler_callback(
         natsConnection* nc, natsSubscription* sub, natsStatus err, void* closure
     ) noexcept
     {
-        std::cerr << std::format(
-            "NatsClient async error: {} - {}\n", (int)err, natsStatus_GetText(err)
-        );
+        NatsEvent event{NatsEventKind::error, err, nc};
+        if (sub)
+        {
+            event.sub_id = natsSubscription_GetID(sub);
+            if (natsSubscription_GetDropped(sub, &event.dropped) != NATS_OK)
+                event.dropped = -1;
+        }
+        emit(closure, event);
+    }
+
+    static unexpected<NatsError> invalid_kv_key(string_view key) noexcept
+    {
+        return unexpected(NatsError(NATS_INVALID_ARG, std::format("Invalid KV key [{}].", key)));
+    }
+
+    /**
+     * Issues `count` requests with up to `depth` in flight, handing their replies
+     * to `complete` in issue order.
+     */
+    template <typename Issue, typename Complete>
+    expected<void, NatsError> pipeline(
+        size_t count, size_t depth, int64_t timeout_ms, Issue&& issue, Complete&& complete
+    ) noexcept
+    {
+        if (!requests)
+        {
+            return unexpected(NatsError(
+                NATS_ILLEGAL_STATE, "Requests are not enabled, call `enable_requests` first."
+            ));
+        }
+        depth = std::clamp<size_t>(depth, 1, requests->capacity());
 
-        int64_t dropped;
-        if (natsSubscription_GetDropped(sub, &dropped) == NATS_OK)
+        vector<std::optional<expected<NatsPendingRequest, NatsError>>> window(depth);
+        auto finish = [&](size_t i)
         {
-            std::cerr << std::format("NatsClient dropped messages so far: {}\n", dropped);
+            auto& pending = *window[i % depth];
+            if (!pending)
+                complete(unexpected(std::move(pending.error())));
+            else
+                complete(pending.value().wait(timeout_ms));
+            window[i % depth].reset();
+        };
+
+        for (size_t i = 0; i < count; ++i)
+        {
+            if (i >= depth)
+                finish(i - depth);
+            window[i % depth].emplace(issue(i));
+        }
+        for (size_t i = count > depth ? count - depth : 0; i < count; ++i)
+            finish(i);
+        return {}; // Success
+    }
+
+    template <typename Subject>
+    expected<void, NatsError> publish_gathered(
+        const Subject& subject, span<const span<const byte>> parts
+    ) noexcept
+    {
+        if (parts.size() == 1)
+            return publish(subject, parts[0]);
+
+        size_t total = 0;
+        for (span<const byte> part : parts)
+            total += part.size();
+
+        // bounded, so a single large payload does not pin memory in every publishing thread
+        thread_local std::unique_ptr<byte[]> buffer;
+        thread_local size_t buffer_size = 0;
+        std::unique_ptr<byte[]> large;
+        byte* out = nullptr;
+        if (total > gather_buffer_max)
+        {
+            large.reset(new (std::nothrow) byte[total]);
+            out = large.get();
+        }
+        else
+        {
+            if (buffer_size < total)
+            {
+                buffer.reset(new (std::nothrow) byte[total]);
+                buffer_size = buffer ? total : 0;
+            }
+            out = buffer.get();
+        }
+        if (!out && total > 0)
+        {
+            return unexpected(NatsError(
+                NATS_NO_MEMORY, std::format("Failed to allocate {} bytes to gather payload.", total)
+            ));
+        }
+
+        byte* p = out;
+        for (span<const byte> part : parts)
+        {
+            if (!part.empty())
+                std::memcpy(p, part.data(), part.size());
+            p += part.size();
+        }
+        return publish(subject, span<const byte>(out, total));
+    }
+
+    static void js_ack_callback(
+        jsCtx* js, natsMsg* msg, jsPubAck* pa, jsPubAckErr* pae, void* closure
+    ) noexcept
+    {
+        JsAckHandler& handler = *static_cast<JsAckHandler*>(closure);
+        NatsMessageView view(msg); // the message is owned by the ack handler
+        if (pae)
+        {
+            handler(
+                view,
+                unexpected(NatsError(
+                    pae->Err,
+                    std::format(
+                        "JetStream async publish failed, error code {}: {}",
+                        pae->ErrCode,
+                        pae->ErrText ? pae->ErrText : ""
+                    )
+                ))
+            );
+            return;
         }
+        handler(view, JsPubAckView{pa});
     }
 
     static void disconnected_callback(natsConnection* conn, void* closure) noexcept
     {
-        std::cerr << "NatsClient disconnected\n";
+        emit(closure, NatsEvent{NatsEventKind::disconnected, NATS_OK, conn});
     }
 
     static void reconnected_callback(natsConnection* conn, void* closure) noexcept
     {
-        std::cerr << "NatsClient reconnected\n";
+        emit(closure, NatsEvent{NatsEventKind::reconnected, NATS_OK, conn});
     }
 
     static void closed_callback(natsConnection* conn, void* closure) noexcept
     {
-        std::cerr << "NatsClient connection closed\n";
+        emit(closure, NatsEvent{NatsEventKind::closed, NATS_OK, conn});
     }
 };
 
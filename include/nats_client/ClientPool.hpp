@@ -0,0 +1,217 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <concepts>
+#include <span>
+#include <string_view>
+#include <vector>
+#include <expected>
+#include <format>
+#include <nats/nats.h>
+
+#include "Client.hpp"
+#include "Error.hpp"
+#include "Stats.hpp"
+#include "Subject.hpp"
+
+namespace nats
+{
+using std::span;
+using std::byte;
+using std::string_view;
+using std::vector;
+using std::expected;
+using std::unexpected;
+
+/**
+ * Fixed set of connections which publishes are spread over by subject.
+ *
+ * A single connection is one socket with one flusher thread, and publishers on it share the
+ * connection lock. The pool routes each publish to the connection selected by a stable hash
+ * of its subject, so messages on one subject keep their order while different subjects are
+ * written, flushed and sent in parallel.
+ *
+ * The publish methods of the pool may be called from many threads at once. They call cnats
+ * directly and keep the status local, whereas `NatsClient` records the last status in
+ * a member shared by all callers.
+ *
+ * Subscriptions, requests and JetStream are used through the individual clients, see `at`.
+ */
+class NatsClientPool
+{
+private:
+    vector<NatsClient> clients;
+
+    NatsClientPool(vector<NatsClient>&& clients) noexcept //
+        : clients(std::move(clients))
+    {
+    }
+
+    static expected<void, NatsError> publish_on(
+        NatsClient& client, const char* subject, string_view shown, span<const byte> data
+    ) noexcept
+    {
+        natsStatus s = natsConnection_Publish(
+            client.connection(), subject, data.data(), static_cast<int>(data.size())
+        );
+        if (s != NATS_OK)
+        {
+            return unexpected(NatsError(
+                s, std::format("Failed to publish {} bytes to subject [{}].", data.size(), shown)
+            ));
+        }
+        return {}; // Success
+    }
+
+    static span<const byte> as_bytes(string_view data) noexcept
+    {
+        return span<const byte>(reinterpret_cast<const byte*>(data.data()), data.size());
+    }
+
+public:
+    /**
+     * Creates `connections` clients, `configure(client, index)` is called on each of them to
+     * set options (e.g. `client.options().set_url(...)`) before `connect`.
+     */
+    template <std::invocable<NatsClient&, size_t> Configure>
+    static expected<NatsClientPool, NatsError> create(
+        size_t connections, Configure&& configure
+    ) noexcept
+    {
+        if (connections == 0)
+            return unexpected(NatsError(NATS_INVALID_ARG, "A pool needs at least one connection."));
+
+        vector<NatsClient> clients;
+        clients.reserve(connections);
+        for (size_t i = 0; i < connections; ++i)
+        {
+            auto res = NatsClient::create();
+            if (!res)
+                return unexpected(res.error());
+            clients.push_back(std::move(res.value()));
+            configure(clients.back(), i);
+        }
+        return NatsClientPool(std::move(clients));
+    }
+
+    /**
+     * Connects all clients, stopping at the first failure.
+     */
+    expected<void, NatsError> connect() noexcept
+    {
+        for (size_t i = 0; i < clients.size(); ++i)
+        {
+            auto res = clients[i].connect();
+            if (!res)
+            {
+                return unexpected(NatsError(
+                    res.error().status,
+                    std::format("Connection {} of the pool: {}", i, res.error().to_string())
+                ));
+            }
+        }
+        return {}; // Success
+    }
+
+    size_t size() const noexcept
+    {
+        return clients.size();
+    }
+
+    NatsClient& at(size_t index) noexcept
+    {
+        return clients[index];
+    }
+
+    /**
+     * Index of the connection a subject is routed to. FNV-1a, which does not depend on the
+     * standard library, so the mapping is the same across processes and builds.
+     */
+    size_t index_of(string_view subject) const noexcept
+    {
+        uint64_t h = 14695981039346656037ull;
+        for (char c : subject)
+        {
+            h ^= static_cast<unsigned char>(c);
+            h *= 1099511628211ull;
+        }
+        return static_cast<size_t>(h % clients.size());
+    }
+
+    NatsClient& route(string_view subject) noexcept
+    {
+        return clients[index_of(subject)];
+    }
+
+    expected<void, NatsError> publish(string_view subject, string_view data) noexcept
+    {
+        return publish_on(route(subject), subject.data(), subject, as_bytes(data));
+    }
+
+    expected<void, NatsError> publish(string_view subject, span<const byte> data) noexcept
+    {
+        return publish_on(route(subject), subject.data(), subject, data);
+    }
+
+    expected<void, NatsError> publish(const NatsSubject& subject, string_view data) noexcept
+    {
+        return publish_on(route(subject.view()), subject.c_str(), subject.view(), as_bytes(data));
+    }
+
+    expected<void, NatsError> publish(const NatsSubject& subject, span<const byte> data) noexcept
+    {
+        return publish_on(route(subject.view()), subject.c_str(), subject.view(), data);
+    }
+
+    template <NatsEncodable T>
+        requires(!std::convertible_to<const T&, string_view> &&
+                 !std::convertible_to<const T&, span<const byte>>)
+    expected<void, NatsError> publish(string_view subject, const T& value) noexcept
+    {
+        return publish(subject, span<const byte>(NatsCodec<T>::encode(value)));
+    }
+
+    template <NatsEncodable T>
+        requires(!std::convertible_to<const T&, string_view> &&
+                 !std::convertible_to<const T&, span<const byte>>)
+    expected<void, NatsError> publish(const NatsSubject& subject, const T& value) noexcept
+    {
+        return publish(subject, span<const byte>(NatsCodec<T>::encode(value)));
+    }
+
+    /**
+     * Flushes all connections one after the other, `timeout_ms` applies to each.
+     */
+    expected<void, NatsError> flush(int64_t timeout_ms) noexcept
+    {
+        for (NatsClient& client : clients)
+        {
+            auto res = client.flush(timeout_ms);
+            if (!res)
+                return res;
+        }
+        return {}; // Success
+    }
+
+    /**
+     * Counters summed over all connections.
+     */
+    expected<NatsConnectionStats, NatsError> stats() noexcept
+    {
+        NatsConnectionStats total;
+        for (NatsClient& client : clients)
+        {
+            auto res = client.stats();
+            if (!res)
+                return unexpected(res.error());
+            total.in_msgs += res->in_msgs;
+            total.in_bytes += res->in_bytes;
+            total.out_msgs += res->out_msgs;
+            total.out_bytes += res->out_bytes;
+            total.reconnects += res->reconnects;
+        }
+        return total;
+    }
+};
+} // namespace nats
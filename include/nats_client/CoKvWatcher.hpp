@@ -0,0 +1,312 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <nats/nats.h>
+
+#include "Error.hpp"
+#include "Coroutine.hpp"
+#include "Kv.hpp"
+
+namespace nats
+{
+using std::optional;
+using std::vector;
+
+/**
+ * Process-wide pool of threads forwarding the updates of KV watchers to coroutines.
+ *
+ * cnats only offers the blocking `kvWatcher_Next`. Instead of one thread per watcher,
+ * each registered watcher is assigned to one of a few lanes, whose thread visits its
+ * watchers round-robin: a visit forwards up to `batch` updates, waiting at most
+ * `poll_timeout_ms` for each. An idle watcher thus costs one short wait per round, so the
+ * delay of an update grows with the number of idle watchers per lane
+ * (about `watchers / threads * poll_timeout_ms`).
+ *
+ * Used by `NatsCoKvWatcher`, the lanes are started with the first registration.
+ */
+class NatsKvWatchPump
+{
+public:
+    struct Config
+    {
+        // lanes, each with its own thread
+        size_t threads = 4;
+        // wait of each `kvWatcher_Next` call
+        int64_t poll_timeout_ms = 1;
+        // updates forwarded per visit of a watcher before moving on to the next one
+        size_t batch = 64;
+    };
+
+    /**
+     * A watcher serviced by the pump. `poll` forwards updates and returns `false`
+     * once the watcher is done, which unregisters it.
+     */
+    struct Source
+    {
+        bool (*poll)(Source* self, int64_t timeout_ms, size_t batch) noexcept;
+        // set by `add`
+        size_t lane;
+    };
+
+private:
+    struct Lane
+    {
+        std::mutex mu;
+        std::condition_variable_any wake;
+        // signaled when a poll is finished, see `remove`
+        std::condition_variable idle;
+        vector<Source*> sources;
+        size_t cursor = 0;
+        Source* polling = nullptr;
+        int64_t poll_timeout_ms = 1;
+        size_t batch = 1;
+        // declared last, so it is stopped before the state above is destroyed
+        std::jthread thread;
+    };
+
+    std::mutex mu;
+    Config config;
+    vector<std::unique_ptr<Lane>> lanes;
+
+    NatsKvWatchPump() noexcept = default;
+
+    static void run(Lane& lane, std::stop_token stop) noexcept
+    {
+        std::unique_lock<std::mutex> lock(lane.mu);
+        while (!stop.stop_requested())
+        {
+            if (lane.sources.empty())
+            {
+                lane.wake.wait(lock, stop, [&]() { return !lane.sources.empty(); });
+                continue;
+            }
+            if (lane.cursor >= lane.sources.size())
+                lane.cursor = 0;
+            Source* src = lane.sources[lane.cursor];
+
+            // polled unlocked, so watchers can be added and removed in the meantime
+            lane.polling = src;
+            lock.unlock();
+            bool active = src->poll(src, lane.poll_timeout_ms, lane.batch);
+            lock.lock();
+            lane.polling = nullptr;
+            lane.idle.notify_all();
+
+            auto it = std::find(lane.sources.begin(), lane.sources.end(), src);
+            if (it == lane.sources.end())
+                continue; // removed while polled
+            size_t index = static_cast<size_t>(it - lane.sources.begin());
+            if (active)
+                lane.cursor = index + 1;
+            else
+                lane.sources.erase(it);
+        }
+    }
+
+    void start() noexcept
+    {
+        size_t count = std::max<size_t>(config.threads, 1);
+        for (size_t i = 0; i < count; ++i)
+        {
+            lanes.push_back(std::make_unique<Lane>());
+            Lane& lane = *lanes.back();
+            lane.poll_timeout_ms = std::max<int64_t>(config.poll_timeout_ms, 1);
+            lane.batch = std::max<size_t>(config.batch, 1);
+            lane.thread = std::jthread([&lane](std::stop_token stop) { run(lane, stop); });
+        }
+    }
+
+public:
+    // Disable copy and move
+    NatsKvWatchPump(const NatsKvWatchPump&) = delete;
+    NatsKvWatchPump& operator=(const NatsKvWatchPump&) = delete;
+
+    static NatsKvWatchPump& instance() noexcept
+    {
+        static NatsKvWatchPump pump;
+        return pump;
+    }
+
+    /**
+     * Changes the settings, only effective before the first watcher is registered.
+     */
+    void configure(const Config& cfg) noexcept
+    {
+        std::lock_guard<std::mutex> lock(mu);
+        config = cfg;
+    }
+
+    /**
+     * Registers a watcher with the lane serving the fewest watchers.
+     */
+    void add(Source* src) noexcept
+    {
+        Lane* target = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(mu);
+            if (lanes.empty())
+                start();
+            size_t fewest = SIZE_MAX;
+            for (size_t i = 0; i < lanes.size(); ++i)
+            {
+                std::lock_guard<std::mutex> lane_lock(lanes[i]->mu);
+                if (lanes[i]->sources.size() < fewest)
+                {
+                    fewest = lanes[i]->sources.size();
+                    src->lane = i;
+                }
+            }
+            target = lanes[src->lane].get();
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(target->mu);
+            target->sources.push_back(src);
+        }
+        target->wake.notify_one();
+    }
+
+    /**
+     * Unregisters a watcher, waiting for a poll of it in progress to finish.
+     * Afterwards the pump no longer refers to it.
+     */
+    void remove(Source* src) noexcept
+    {
+        Lane* lane = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(mu);
+            lane = lanes[src->lane].get();
+        }
+
+        std::unique_lock<std::mutex> lock(lane->mu);
+        auto it = std::find(lane->sources.begin(), lane->sources.end(), src);
+        if (it != lane->sources.end())
+        {
+            size_t index = static_cast<size_t>(it - lane->sources.begin());
+            lane->sources.erase(it);
+            if (index < lane->cursor)
+                --lane->cursor;
+        }
+        lane->idle.wait(lock, [&]() { return lane->polling != src; });
+    }
+
+    /**
+     * Watchers currently registered, over all lanes.
+     */
+    size_t watchers() noexcept
+    {
+        std::lock_guard<std::mutex> lock(mu);
+        size_t total = 0;
+        for (auto& lane : lanes)
+        {
+            std::lock_guard<std::mutex> lane_lock(lane->mu);
+            total += lane->sources.size();
+        }
+        return total;
+    }
+};
+
+/**
+ * KeyValue watcher whose updates are awaited from a coroutine with `co_await watcher.next()`.
+ *
+ * Updates are forwarded by the shared `NatsKvWatchPump`, so thousands of watchers share
+ * a few threads, and the awaiting coroutine is resumed on the executor. While the buffer
+ * of `capacity` updates is full, the watcher is skipped instead of blocking its lane.
+ * The semantics of `next` match `KvWatcher::next`: `std::nullopt` marks the end
+ * of the initial state.
+ */
+template <NatsExecutor Executor>
+class NatsCoKvWatcher
+{
+private:
+    using Channel = NatsCoChannel<optional<KvEntry>, Executor>;
+
+    struct State : NatsKvWatchPump::Source
+    {
+        Channel channel;
+        KvWatcher watcher;
+        // update taken from the watcher while the channel was full
+        optional<optional<KvEntry>> pending;
+
+        State(KvWatcher&& kv_watcher, Executor& executor, size_t capacity)
+            : NatsKvWatchPump::Source{poll, 0},
+              channel(executor, capacity),
+              watcher(std::move(kv_watcher))
+        {
+        }
+
+        static bool poll(NatsKvWatchPump::Source* self, int64_t timeout_ms, size_t batch) noexcept
+        {
+            State& st = *static_cast<State*>(self);
+            for (size_t i = 0; i < batch; ++i)
+            {
+                if (!st.pending)
+                {
+                    auto res = st.watcher.next(timeout_ms);
+                    if (!res)
+                    {
+                        if (res.error().status == NATS_TIMEOUT)
+                            return true;
+                        st.channel.close(res.error().status);
+                        return false;
+                    }
+                    st.pending.emplace(std::move(res.value()));
+                }
+                if (!st.channel.try_push(*st.pending))
+                    return true;
+                st.pending.reset();
+            }
+            return true;
+        }
+    };
+
+    // heap allocated, the pump refers to it
+    std::unique_ptr<State> state;
+
+public:
+    NatsCoKvWatcher(KvWatcher&& kv_watcher, Executor& executor, size_t capacity = 1024)
+        : state(std::make_unique<State>(std::move(kv_watcher), executor, capacity))
+    {
+        NatsKvWatchPump::instance().add(state.get());
+    }
+
+    ~NatsCoKvWatcher()
+    {
+        NatsKvWatchPump::instance().remove(state.get());
+        (void)state->watcher.stop();
+        state->channel.close(NATS_ILLEGAL_STATE);
+    }
+
+    // Disable copy and move, the pump refers to this object
+    NatsCoKvWatcher(const NatsCoKvWatcher&) = delete;
+    NatsCoKvWatcher& operator=(const NatsCoKvWatcher&) = delete;
+
+    /**
+     * Awaitable returning `expected<optional<KvEntry>, NatsError>`.
+     *
+     * Fails with status-only `NATS_ILLEGAL_STATE` once the watcher is stopped.
+     * Only one coroutine may await `next` at a time.
+     */
+    auto next() noexcept
+    {
+        return state->channel.next();
+    }
+
+    /**
+     * Stops the watcher, a coroutine awaiting `next` is resumed with an error.
+     */
+    expected<void, NatsError> stop() noexcept
+    {
+        return state->watcher.stop();
+    }
+};
+} // namespace nats
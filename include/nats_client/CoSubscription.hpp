@@ -0,0 +1,101 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <utility>
+#include <nats/nats.h>
+
+#include "Coroutine.hpp"
+#include "MessageView.hpp"
+#include "SubscriptionAsync.hpp"
+
+namespace nats
+{
+class NatsClient;
+
+/**
+ * Subscription whose messages are awaited from a coroutine with `co_await sub.next()`.
+ *
+ * Built on `NatsSubscriptionAsync`: the delivery thread hands messages to the awaiting
+ * coroutine, which is resumed on the executor, or buffers up to `capacity` messages.
+ * Created by `NatsClient::co_subscribe`.
+ */
+template <NatsExecutor Executor>
+class NatsCoSubscription
+{
+private:
+    friend class NatsClient;
+
+    using Channel = NatsCoChannel<NatsMessageView, Executor>;
+
+    struct Pump
+    {
+        Channel* channel;
+
+        void operator()(NatsMessageView& msg) noexcept
+        {
+            channel->push(std::move(msg));
+        }
+
+        void on_complete() noexcept
+        {
+            channel->close(NATS_INVALID_SUBSCRIPTION);
+        }
+    };
+
+    std::unique_ptr<Channel> channel;
+    // declared last, so delivery is stopped before the channel is destroyed
+    NatsSubscriptionAsync<Pump> sub;
+
+    NatsCoSubscription(std::unique_ptr<Channel>&& ch, NatsSubscriptionAsync<Pump>&& s) noexcept
+        : channel(std::move(ch)), sub(std::move(s))
+    {
+    }
+
+public:
+    ~NatsCoSubscription()
+    {
+        // unblocks a delivery thread waiting for buffer space before unsubscribing
+        if (channel)
+            channel->close(NATS_INVALID_SUBSCRIPTION);
+    }
+
+    // Disable copy
+    NatsCoSubscription(const NatsCoSubscription&) = delete;
+    NatsCoSubscription& operator=(const NatsCoSubscription&) = delete;
+
+    // Enable move
+    NatsCoSubscription(NatsCoSubscription&&) noexcept = default;
+    NatsCoSubscription& operator=(NatsCoSubscription&& other) noexcept
+    {
+        if (this != &other)
+        {
+            if (channel)
+                channel->close(NATS_INVALID_SUBSCRIPTION);
+            sub = std::move(other.sub);
+            channel = std::move(other.channel);
+        }
+        return *this;
+    }
+
+    /**
+     * Awaitable returning `expected<NatsMessageView, NatsError>`.
+     *
+     * Fails with status-only `NATS_INVALID_SUBSCRIPTION` once the subscription
+     * is closed and all buffered messages have been returned.
+     * Only one coroutine may await `next` at a time.
+     */
+    auto next() noexcept
+    {
+        return channel->next();
+    }
+
+    /**
+     * Returns the underlying asynchronous subscription, e.g. to query stats or drain.
+     */
+    NatsSubscriptionAsync<Pump>& subscription() noexcept
+    {
+        return sub;
+    }
+};
+} // namespace nats
@@ -0,0 +1,138 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <array>
+#include <bit>
+#include <concepts>
+#include <memory>
+#include <span>
+#include <string_view>
+#include <type_traits>
+#include <expected>
+#include <format>
+#include <nats/nats.h>
+
+#include "Error.hpp"
+
+namespace nats
+{
+using std::span;
+using std::byte;
+using std::string_view;
+using std::expected;
+using std::unexpected;
+
+/**
+ * Payload codec, the customization point of `NatsClient::publish(subject, value)` and
+ * `NatsMessageView::as<T>()`. Specialize it for a type with either or both of:
+ *
+ * - `static span<const byte> encode(const T& value) noexcept`, returning the serialized bytes,
+ *   which only need to stay valid until the publish call returns
+ * - `static expected<R, NatsError> decode(span<const byte> data) noexcept`, where `R` may be
+ *   a value or a view into `data` (valid as long as the message)
+ *
+ * Zero-copy formats such as FlatBuffers fit by encoding from a finished builder buffer and
+ * decoding to a verified root table pointer.
+ */
+template <typename T>
+struct NatsCodec
+{
+};
+
+template <typename T>
+concept NatsEncodable = requires(const T& value) {
+    { NatsCodec<T>::encode(value) } -> std::convertible_to<span<const byte>>;
+};
+
+template <typename T>
+concept NatsDecodable = requires(span<const byte> data) { NatsCodec<T>::decode(data); };
+
+/**
+ * Opt-in to the flat codec, enabled for arithmetic and enum types.
+ *
+ * Whether a trivially copyable struct holds pointers or views (e.g. `std::span`,
+ * `std::string_view`) cannot be detected, and sending those would send addresses.
+ * Enable it for plain data structs by specializing:
+ *
+ *     template <>
+ *     inline constexpr bool nats::nats_flat_enabled<Quote> = true;
+ */
+template <typename T>
+inline constexpr bool nats_flat_enabled = std::is_arithmetic_v<T> || std::is_enum_v<T>;
+
+/**
+ * Types sent as their object representation: opted in via `nats_flat_enabled`,
+ * trivially copyable, non-empty, no pointers.
+ * Padding bytes are sent as they are, and both ends must agree on layout and endianness.
+ */
+template <typename T>
+concept NatsFlat = nats_flat_enabled<T> && std::is_trivially_copyable_v<T> &&
+                   !std::is_empty_v<T> && !std::is_pointer_v<T> &&
+                   !std::is_member_pointer_v<T> && !std::is_array_v<T>;
+
+/**
+ * Flat types are encoded as a view of the value and decoded with a single copy,
+ * so the payload needs no particular alignment.
+ */
+template <NatsFlat T>
+struct NatsCodec<T>
+{
+    static span<const byte> encode(const T& value) noexcept
+    {
+        const byte* bytes = reinterpret_cast<const byte*>(std::addressof(value));
+        return span<const byte>(bytes, sizeof(T));
+    }
+
+    static expected<T, NatsError> decode(span<const byte> data) noexcept
+    {
+        if (data.size() != sizeof(T))
+        {
+            return unexpected(NatsError(
+                NATS_INVALID_ARG,
+                std::format(
+                    "Payload of {} bytes does not match type of {} bytes.", data.size(), sizeof(T)
+                )
+            ));
+        }
+        std::array<byte, sizeof(T)> raw;
+        std::memcpy(raw.data(), data.data(), sizeof(T));
+        return std::bit_cast<T>(raw);
+    }
+};
+
+/**
+ * Decodes a flat type as a pointer into the payload, without copying.
+ * Fails with `NATS_INVALID_ARG` if the payload is not suitably aligned for `T`.
+ *
+ * `msg.as<NatsFlatView<T>>()` returns `expected<const T*, NatsError>`.
+ */
+template <NatsFlat T>
+struct NatsFlatView
+{
+    static_assert(
+        alignof(T) <= alignof(std::max_align_t), "over-aligned types cannot be viewed in place"
+    );
+};
+
+template <NatsFlat T>
+struct NatsCodec<NatsFlatView<T>>
+{
+    static expected<const T*, NatsError> decode(span<const byte> data) noexcept
+    {
+        if (data.size() != sizeof(T))
+        {
+            return unexpected(NatsError(
+                NATS_INVALID_ARG,
+                std::format(
+                    "Payload of {} bytes does not match type of {} bytes.", data.size(), sizeof(T)
+                )
+            ));
+        }
+        if (reinterpret_cast<uintptr_t>(data.data()) % alignof(T) != 0)
+            return unexpected(NatsError(NATS_INVALID_ARG, "Payload is not aligned for a view."));
+        return reinterpret_cast<const T*>(data.data());
+    }
+};
+} // namespace nats
@@ -0,0 +1,479 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <coroutine>
+#include <concepts>
+#include <exception>
+#include <expected>
+#include <optional>
+#include <utility>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <new>
+#include <nats/nats.h>
+
+#include "Error.hpp"
+
+namespace nats
+{
+using std::expected;
+using std::unexpected;
+using std::optional;
+using std::vector;
+
+/**
+ * Executor on which suspended coroutines are resumed.
+ *
+ * `post` is called from cnats delivery threads and must be thread-safe.
+ */
+template <typename Executor>
+concept NatsExecutor = requires(Executor& e, std::coroutine_handle<> h) { e.post(h); };
+
+/**
+ * Resumes coroutines directly on the thread that completes the operation,
+ * e.g. the cnats delivery thread of the subscription.
+ */
+struct NatsInlineExecutor
+{
+    void post(std::coroutine_handle<> h) noexcept
+    {
+        h.resume();
+    }
+};
+
+/**
+ * Pool for coroutine frames of `NatsTask`.
+ *
+ * Frames are rounded up to size classes and recycled through per-thread free lists,
+ * so creating and finishing tasks in steady state does not hit the global allocator.
+ * Frames freed on another thread than the allocating one are cached by the freeing thread,
+ * up to `max_cached` per size class, beyond that they are returned to the global allocator.
+ */
+class NatsFramePool
+{
+private:
+    static constexpr size_t granularity = 64;
+    static constexpr size_t class_count = 32; // frames up to 2 KB are pooled
+    static constexpr uint32_t max_cached = 256;
+
+    struct Node
+    {
+        Node* next;
+    };
+
+    struct Cache
+    {
+        Node* heads[class_count]{};
+        uint32_t counts[class_count]{};
+
+        ~Cache()
+        {
+            for (size_t c = 0; c < class_count; ++c)
+            {
+                while (Node* node = heads[c])
+                {
+                    heads[c] = node->next;
+                    ::operator delete(node);
+                }
+            }
+        }
+    };
+
+    static Cache& cache() noexcept
+    {
+        thread_local Cache c;
+        return c;
+    }
+
+    static size_t class_of(size_t size) noexcept
+    {
+        return (size + granularity - 1) / granularity - 1;
+    }
+
+public:
+    static void* allocate(size_t size)
+    {
+        size_t c = class_of(size);
+        if (c >= class_count)
+            return ::operator new(size);
+
+        Cache& ca = cache();
+        if (Node* node = ca.heads[c])
+        {
+            ca.heads[c] = node->next;
+            --ca.counts[c];
+            return node;
+        }
+        return ::operator new((c + 1) * granularity);
+    }
+
+    static void deallocate(void* ptr, size_t size) noexcept
+    {
+        size_t c = class_of(size);
+        Cache& ca = cache();
+        if (c >= class_count || ca.counts[c] >= max_cached)
+        {
+            ::operator delete(ptr);
+            return;
+        }
+        Node* node = static_cast<Node*>(ptr);
+        node->next = ca.heads[c];
+        ca.heads[c] = node;
+        ++ca.counts[c];
+    }
+};
+
+template <typename T>
+class NatsTask;
+
+/**
+ * Promise parts shared by `NatsTask<T>` and `NatsTask<void>`.
+ */
+struct NatsTaskPromiseBase
+{
+    std::coroutine_handle<> continuation;
+    bool detached = false;
+
+    static void* operator new(size_t size)
+    {
+        return NatsFramePool::allocate(size);
+    }
+
+    static void operator delete(void* ptr, size_t size) noexcept
+    {
+        NatsFramePool::deallocate(ptr, size);
+    }
+
+    struct FinalAwaiter
+    {
+        bool await_ready() noexcept
+        {
+            return false;
+        }
+
+        template <typename Promise>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> h) noexcept
+        {
+            NatsTaskPromiseBase& p = h.promise();
+            if (p.continuation)
+                return p.continuation;
+            if (p.detached)
+                h.destroy();
+            return std::noop_coroutine();
+        }
+
+        void await_resume() noexcept
+        {
+        }
+    };
+
+    std::suspend_always initial_suspend() noexcept
+    {
+        return {};
+    }
+
+    FinalAwaiter final_suspend() noexcept
+    {
+        return {};
+    }
+
+    void unhandled_exception() noexcept
+    {
+        std::terminate();
+    }
+};
+
+template <typename T>
+struct NatsTaskPromise : NatsTaskPromiseBase
+{
+    optional<T> value;
+
+    NatsTask<T> get_return_object() noexcept;
+
+    void return_value(T v) noexcept
+    {
+        value.emplace(std::move(v));
+    }
+
+    T result() noexcept
+    {
+        return std::move(*value);
+    }
+};
+
+template <>
+struct NatsTaskPromise<void> : NatsTaskPromiseBase
+{
+    NatsTask<void> get_return_object() noexcept;
+
+    void return_void() noexcept
+    {
+    }
+
+    void result() noexcept
+    {
+    }
+};
+
+/**
+ * Lazily started coroutine task with pooled frame allocation.
+ *
+ * A task starts when awaited (`co_await task`), or when `detach` is called,
+ * in which case its frame is freed when the coroutine finishes.
+ */
+template <typename T = void>
+class [[nodiscard]] NatsTask
+{
+public:
+    using promise_type = NatsTaskPromise<T>;
+
+private:
+    std::coroutine_handle<promise_type> handle;
+
+public:
+    explicit NatsTask(std::coroutine_handle<promise_type> h) noexcept //
+        : handle(h)
+    {
+    }
+
+    ~NatsTask()
+    {
+        if (handle)
+        {
+            handle.destroy();
+            handle = nullptr;
+        }
+    }
+
+    // Disable copy
+    NatsTask(const NatsTask&) = delete;
+    NatsTask& operator=(const NatsTask&) = delete;
+
+    // Enable move
+    NatsTask(NatsTask&& other) noexcept : handle(std::exchange(other.handle, nullptr))
+    {
+    }
+    NatsTask& operator=(NatsTask&& other) noexcept
+    {
+        if (this != &other)
+        {
+            if (handle)
+                handle.destroy();
+            handle = std::exchange(other.handle, nullptr);
+        }
+        return *this;
+    }
+
+    /**
+     * Starts the task without awaiting it.
+     *
+     * Runs on the calling thread until the first suspension point,
+     * the frame is freed when the coroutine finishes.
+     */
+    void detach() noexcept
+    {
+        auto h = std::exchange(handle, nullptr);
+        h.promise().detached = true;
+        h.resume();
+    }
+
+    auto operator co_await() && noexcept
+    {
+        struct Awaiter
+        {
+            std::coroutine_handle<promise_type> handle;
+
+            bool await_ready() noexcept
+            {
+                return handle.done();
+            }
+
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept
+            {
+                handle.promise().continuation = awaiting;
+                return handle;
+            }
+
+            T await_resume() noexcept
+            {
+                return handle.promise().result();
+            }
+        };
+        return Awaiter{handle};
+    }
+};
+
+template <typename T>
+inline NatsTask<T> NatsTaskPromise<T>::get_return_object() noexcept
+{
+    return NatsTask<T>(std::coroutine_handle<NatsTaskPromise<T>>::from_promise(*this));
+}
+
+inline NatsTask<void> NatsTaskPromise<void>::get_return_object() noexcept
+{
+    return NatsTask<void>(std::coroutine_handle<NatsTaskPromise<void>>::from_promise(*this));
+}
+
+/**
+ * Bounded single-consumer queue between a cnats thread and a coroutine.
+ *
+ * The producer hands values directly to a suspended consumer and resumes it on the executor,
+ * otherwise values are buffered in a pre-allocated ring. If the ring is full, the producer
+ * blocks, which pushes back into the pending limits of the underlying cnats subscription.
+ * Only one coroutine may await `next` at a time.
+ */
+template <typename T, NatsExecutor Executor>
+class NatsCoChannel
+{
+private:
+    struct NextAwaitable;
+
+    std::mutex mu;
+    std::condition_variable not_full;
+    vector<optional<T>> ring;
+    size_t head = 0;
+    size_t count = 0;
+    natsStatus closed_status = NATS_OK;
+    NextAwaitable* waiting = nullptr;
+    Executor& executor;
+
+    struct NextAwaitable
+    {
+        NatsCoChannel* channel;
+        std::coroutine_handle<> handle;
+        optional<T> value;
+        natsStatus status = NATS_OK;
+
+        bool await_ready() noexcept
+        {
+            return false;
+        }
+
+        bool await_suspend(std::coroutine_handle<> h) noexcept
+        {
+            std::unique_lock<std::mutex> lock(channel->mu);
+            if (channel->count > 0)
+            {
+                value = channel->pop();
+                lock.unlock();
+                channel->not_full.notify_one();
+                return false;
+            }
+            if (channel->closed_status != NATS_OK)
+            {
+                status = channel->closed_status;
+                return false;
+            }
+            handle = h;
+            channel->waiting = this;
+            return true;
+        }
+
+        expected<T, NatsError> await_resume() noexcept
+        {
+            if (value)
+                return std::move(*value);
+            return unexpected(NatsError(status));
+        }
+    };
+
+    T pop() noexcept
+    {
+        T v = std::move(*ring[head]);
+        ring[head].reset();
+        head = (head + 1) % ring.size();
+        --count;
+        return v;
+    }
+
+public:
+    NatsCoChannel(Executor& executor, size_t capacity) //
+        : ring(capacity == 0 ? 1 : capacity), executor(executor)
+    {
+    }
+
+    // Disable copy and move, the address is shared with the producer
+    NatsCoChannel(const NatsCoChannel&) = delete;
+    NatsCoChannel& operator=(const NatsCoChannel&) = delete;
+
+    /**
+     * Called by the producer thread. Values pushed after `close` are dropped.
+     */
+    void push(T&& v) noexcept
+    {
+        std::unique_lock<std::mutex> lock(mu);
+        // the consumer may drain the ring and suspend while the producer is blocked here,
+        // so a waiter is checked for again after waking up
+        not_full.wait(
+            lock,
+            [&]() { return waiting || count < ring.size() || closed_status != NATS_OK; }
+        );
+        if (closed_status != NATS_OK)
+            return;
+        if (waiting)
+        {
+            // only suspends on an empty ring, so there is nothing buffered to overtake
+            NextAwaitable* w = std::exchange(waiting, nullptr);
+            w->value.emplace(std::move(v));
+            lock.unlock();
+            executor.post(w->handle);
+            return;
+        }
+        ring[(head + count) % ring.size()].emplace(std::move(v));
+        ++count;
+    }
+
+    /**
+     * Non-blocking `push` for a producer serving several channels. Returns `false` if the
+     * ring is full, in which case `v` is left untouched, otherwise `v` is moved from.
+     */
+    bool try_push(T& v) noexcept
+    {
+        std::unique_lock<std::mutex> lock(mu);
+        if (closed_status != NATS_OK)
+            return true;
+        if (waiting)
+        {
+            NextAwaitable* w = std::exchange(waiting, nullptr);
+            w->value.emplace(std::move(v));
+            lock.unlock();
+            executor.post(w->handle);
+            return true;
+        }
+        if (count == ring.size())
+            return false;
+        ring[(head + count) % ring.size()].emplace(std::move(v));
+        ++count;
+        return true;
+    }
+
+    /**
+     * Ends the channel, a waiting consumer is resumed with a status-only error.
+     * Values already buffered are still returned by `next`.
+     */
+    void close(natsStatus status) noexcept
+    {
+        std::unique_lock<std::mutex> lock(mu);
+        if (closed_status != NATS_OK)
+            return;
+        closed_status = status;
+        NextAwaitable* w = std::exchange(waiting, nullptr);
+        if (w)
+            w->status = status;
+        lock.unlock();
+        not_full.notify_all();
+        if (w)
+            executor.post(w->handle);
+    }
+
+    /**
+     * Awaitable returning `expected<T, NatsError>`.
+     */
+    NextAwaitable next() noexcept
+    {
+        return NextAwaitable{this, {}, std::nullopt};
+    }
+};
+} // namespace nats
@@ -24,17 +24,31 @@ struct NatsError
 
     /**
      * Error message provided by the `NatsClient` c++ wrapper.
+     * Empty for status-only errors.
      */
     string message;
 
     NatsError(natsStatus s, string message) noexcept //
-        : status(s), message(message)
+        : status(s), message(std::move(message))
+    {
+        status_text = natsStatus_GetText(s);
+    }
+
+    /**
+     * Creates a status-only error without a wrapper message.
+     *
+     * Does not allocate, used for expected outcomes on hot paths like `NATS_TIMEOUT`.
+     */
+    explicit NatsError(natsStatus s) noexcept //
+        : status(s)
     {
         status_text = natsStatus_GetText(s);
     }
 
     string to_string() const noexcept
     {
+        if (message.empty())
+            return std::format("NATS error {}: {}", (int)status, status_text);
         return std::format("NATS error {}: {} - {}", (int)status, status_text, message);
     }
 };
@@ -0,0 +1,302 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cerrno>
+#include <cstring>
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+#include <expected>
+#include <format>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <nats/nats.h>
+
+#include "Error.hpp"
+
+namespace nats
+{
+using std::expected;
+using std::unexpected;
+using std::vector;
+
+/**
+ * Single-threaded epoll event loop driving the socket I/O of many connections.
+ *
+ * Pass it to `NatsOptions::set_event_loop` before connecting: cnats then does not start
+ * its reader and flusher threads for the connection, reads and writes are performed by
+ * the thread calling `run` (or `run_once`) instead.
+ * Message callbacks of async subscriptions still run on the cnats delivery threads,
+ * see `NatsOptions::use_global_message_delivery` to share these as well.
+ *
+ * The loop must outlive the connections attached to it.
+ *
+ * Connections attached to the loop must be closed and destroyed on the loop thread,
+ * e.g. by destroying their `NatsClient` in a task passed to `post`. Closing detaches the
+ * connection, and the loop cannot tell a detach on another thread from a read or write
+ * event of the same connection it is dispatching at that moment: cnats calls back into
+ * `read`/`write` from the dispatch, so the dispatch cannot be guarded by the handle lock.
+ */
+class NatsEpollLoop
+{
+private:
+    // Per-connection registration, passed to cnats as `userData`
+    struct Handle
+    {
+        NatsEpollLoop* loop;
+        natsConnection* nc;
+        int fd = -1;
+        uint32_t events = 0;
+        std::mutex mu;
+        std::atomic<bool> detached{false};
+
+        Handle(NatsEpollLoop* loop, natsConnection* nc) noexcept : loop(loop), nc(nc)
+        {
+        }
+    };
+
+    int epfd = -1;
+    int wakefd = -1;
+    std::atomic<bool> stopping{false};
+    vector<epoll_event> ready;
+
+    // Detached handles are freed by the loop thread, once no event of theirs can be in flight
+    std::mutex retired_mu;
+    vector<Handle*> retired;
+
+    // Tasks run by the loop thread after dispatching events, see `post`
+    std::mutex posted_mu;
+    vector<std::function<void()>> posted;
+    vector<std::function<void()>> running;
+
+    NatsEpollLoop() noexcept = default;
+
+    static NatsError sys_error(const char* what) noexcept
+    {
+        return NatsError(NATS_SYS_ERROR, std::format("{} failed: {}.", what, std::strerror(errno)));
+    }
+
+    void free_retired() noexcept
+    {
+        std::lock_guard<std::mutex> lock(retired_mu);
+        for (Handle* h : retired)
+            delete h;
+        retired.clear();
+    }
+
+    void run_posted() noexcept
+    {
+        {
+            std::lock_guard<std::mutex> lock(posted_mu);
+            running.swap(posted);
+        }
+        for (auto& task : running)
+            task();
+        running.clear();
+    }
+
+    static natsStatus update(Handle* h, uint32_t event, bool add) noexcept
+    {
+        std::lock_guard<std::mutex> lock(h->mu);
+        uint32_t events = add ? (h->events | event) : (h->events & ~event);
+        if (events == h->events || h->detached.load(std::memory_order_relaxed))
+            return NATS_OK;
+
+        epoll_event ev{};
+        ev.events = events;
+        ev.data.ptr = h;
+        if (epoll_ctl(h->loop->epfd, EPOLL_CTL_MOD, h->fd, &ev) != 0)
+            return NATS_SYS_ERROR;
+        h->events = events;
+        return NATS_OK;
+    }
+
+public:
+    ~NatsEpollLoop()
+    {
+        free_retired();
+        if (wakefd >= 0)
+            ::close(wakefd);
+        if (epfd >= 0)
+            ::close(epfd);
+    }
+
+    // Disable copy and move, the address is registered with cnats
+    NatsEpollLoop(const NatsEpollLoop&) = delete;
+    NatsEpollLoop& operator=(const NatsEpollLoop&) = delete;
+
+    /**
+     * Creates the loop, `max_events` is the number of ready sockets handled per wakeup.
+     */
+    static expected<std::unique_ptr<NatsEpollLoop>, NatsError> create(size_t max_events = 64
+    ) noexcept
+    {
+        std::unique_ptr<NatsEpollLoop> loop(new (std::nothrow) NatsEpollLoop());
+        if (!loop)
+            return unexpected(NatsError(NATS_NO_MEMORY, "Failed to allocate event loop."));
+
+        if ((loop->epfd = epoll_create1(EPOLL_CLOEXEC)) < 0)
+            return unexpected(sys_error("epoll_create1"));
+        if ((loop->wakefd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) < 0)
+            return unexpected(sys_error("eventfd"));
+
+        epoll_event ev{};
+        ev.events = EPOLLIN;
+        ev.data.ptr = nullptr; // marks the wakeup descriptor
+        if (epoll_ctl(loop->epfd, EPOLL_CTL_ADD, loop->wakefd, &ev) != 0)
+            return unexpected(sys_error("epoll_ctl"));
+
+        loop->ready.resize(max_events == 0 ? 1 : max_events);
+        return loop;
+    }
+
+    /**
+     * Waits up to `timeout_ms` (-1 for no timeout) for socket events and processes them,
+     * then runs the tasks posted so far. Returns the number of events processed.
+     */
+    expected<size_t, NatsError> run_once(int timeout_ms) noexcept
+    {
+        free_retired();
+
+        int n = epoll_wait(epfd, ready.data(), static_cast<int>(ready.size()), timeout_ms);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                return 0;
+            return unexpected(sys_error("epoll_wait"));
+        }
+
+        for (int i = 0; i < n; ++i)
+        {
+            Handle* h = static_cast<Handle*>(ready[i].data.ptr);
+            if (!h)
+            {
+                uint64_t count;
+                (void)::read(wakefd, &count, sizeof(count));
+                continue;
+            }
+
+            uint32_t events = ready[i].events;
+            if ((events & (EPOLLIN | EPOLLERR | EPOLLHUP)) &&
+                !h->detached.load(std::memory_order_acquire))
+                natsConnection_ProcessReadEvent(h->nc);
+            if ((events & EPOLLOUT) && !h->detached.load(std::memory_order_acquire))
+                natsConnection_ProcessWriteEvent(h->nc);
+        }
+
+        run_posted();
+        return static_cast<size_t>(n);
+    }
+
+    /**
+     * Processes events on the calling thread until `stop` is called.
+     */
+    expected<void, NatsError> run() noexcept
+    {
+        stopping.store(false, std::memory_order_relaxed);
+        while (!stopping.load(std::memory_order_acquire))
+        {
+            auto res = run_once(-1);
+            if (!res)
+                return unexpected(res.error());
+        }
+        return {}; // Success
+    }
+
+    /**
+     * Makes `run` return, can be called from any thread.
+     */
+    void stop() noexcept
+    {
+        stopping.store(true, std::memory_order_release);
+        uint64_t one = 1;
+        (void)::write(wakefd, &one, sizeof(one));
+    }
+
+    /**
+     * Runs `task` on the loop thread, between dispatches of socket events, and wakes up
+     * the loop. Can be called from any thread, e.g. to close a connection attached to it.
+     */
+    void post(std::function<void()> task) noexcept
+    {
+        {
+            std::lock_guard<std::mutex> lock(posted_mu);
+            posted.push_back(std::move(task));
+        }
+        uint64_t one = 1;
+        (void)::write(wakefd, &one, sizeof(one));
+    }
+
+    // cnats event loop callbacks, see `NatsOptions::set_event_loop`
+
+    static natsStatus attach(void** user_data, void* loop, natsConnection* nc, natsSock socket)
+        noexcept
+    {
+        auto* self = static_cast<NatsEpollLoop*>(loop);
+        auto* h = static_cast<Handle*>(*user_data);
+        bool created = false;
+        if (!h)
+        {
+            // first attach, on reconnect the handle is reused with the new socket
+            if (!(h = new (std::nothrow) Handle(self, nc)))
+                return NATS_NO_MEMORY;
+            created = true;
+        }
+
+        std::unique_lock<std::mutex> lock(h->mu);
+        if (h->fd >= 0)
+            (void)epoll_ctl(self->epfd, EPOLL_CTL_DEL, h->fd, nullptr); // may be closed already
+
+        h->fd = static_cast<int>(socket);
+        h->events = EPOLLIN;
+        epoll_event ev{};
+        ev.events = h->events;
+        ev.data.ptr = h;
+        if (epoll_ctl(self->epfd, EPOLL_CTL_ADD, h->fd, &ev) != 0)
+        {
+            h->fd = -1;
+            lock.unlock();
+            if (created)
+                delete h;
+            return NATS_SYS_ERROR;
+        }
+        *user_data = h;
+        return NATS_OK;
+    }
+
+    static natsStatus read(void* user_data, bool add) noexcept
+    {
+        return update(static_cast<Handle*>(user_data), EPOLLIN, add);
+    }
+
+    static natsStatus write(void* user_data, bool add) noexcept
+    {
+        return update(static_cast<Handle*>(user_data), EPOLLOUT, add);
+    }
+
+    /**
+     * Called by cnats when the connection is closed, on the thread closing it,
+     * which must be the loop thread (see the class documentation).
+     */
+    static natsStatus detach(void* user_data) noexcept
+    {
+        auto* h = static_cast<Handle*>(user_data);
+        NatsEpollLoop* self = h->loop;
+        {
+            std::lock_guard<std::mutex> lock(h->mu);
+            h->detached.store(true, std::memory_order_release);
+            if (h->fd >= 0)
+                (void)epoll_ctl(self->epfd, EPOLL_CTL_DEL, h->fd, nullptr);
+        }
+        std::lock_guard<std::mutex> lock(self->retired_mu);
+        self->retired.push_back(h);
+        return NATS_OK;
+    }
+};
+} // namespace nats
@@ -0,0 +1,225 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <format>
+#include <nats/nats.h>
+
+namespace nats
+{
+using std::string;
+
+enum class NatsEventKind : uint8_t
+{
+    error,
+    disconnected,
+    reconnected,
+    closed,
+};
+
+/**
+ * Asynchronous error or connection state change, captured on a cnats thread.
+ *
+ * Only plain values are captured, so events can be handled after the subscription
+ * or connection they refer to is gone.
+ */
+struct NatsEvent
+{
+    NatsEventKind kind;
+    natsStatus status{NATS_OK};
+    // identifies the connection, not to be dereferenced when handled asynchronously
+    const natsConnection* conn{nullptr};
+    // subscription the error refers to, 0 if none
+    int64_t sub_id{0};
+    // messages dropped by that subscription so far, -1 if unknown
+    int64_t dropped{-1};
+    // steady clock, in nanoseconds
+    int64_t timestamp_ns{0};
+
+    string to_string() const
+    {
+        switch (kind)
+        {
+        case NatsEventKind::error:
+            if (sub_id != 0)
+            {
+                return std::format(
+                    "NatsClient async error: {} - {} (subscription {}, dropped so far: {})",
+                    static_cast<int>(status),
+                    natsStatus_GetText(status),
+                    sub_id,
+                    dropped
+                );
+            }
+            return std::format(
+                "NatsClient async error: {} - {}",
+                static_cast<int>(status),
+                natsStatus_GetText(status)
+            );
+        case NatsEventKind::disconnected:
+            return "NatsClient disconnected";
+        case NatsEventKind::reconnected:
+            return "NatsClient reconnected";
+        case NatsEventKind::closed:
+            return "NatsClient connection closed";
+        }
+        return "NatsClient unknown event";
+    }
+};
+
+/**
+ * Receives the asynchronous events of a connection, see `NatsClient::set_event_sink`.
+ *
+ * `on_event` is called on cnats threads, including the message delivery threads,
+ * and must not block.
+ */
+class NatsEventSink
+{
+public:
+    virtual ~NatsEventSink() = default;
+    virtual void on_event(const NatsEvent& event) noexcept = 0;
+};
+
+/**
+ * Event sink which queues events into a bounded lock-free ring and hands them to a
+ * handler on its own background thread.
+ *
+ * Producers never block or allocate: if the ring is full, the event is dropped and counted.
+ * The default handler prints events to `std::cerr`.
+ */
+class NatsAsyncEventSink final : public NatsEventSink
+{
+public:
+    using Handler = std::function<void(const NatsEvent&)>;
+
+private:
+    // Bounded multi-producer queue (Vyukov), each cell carries its own sequence number
+    struct Cell
+    {
+        std::atomic<size_t> sequence;
+        NatsEvent event;
+    };
+
+    std::unique_ptr<Cell[]> cells;
+    size_t mask;
+    alignas(64) std::atomic<size_t> enqueue_pos{0};
+    alignas(64) size_t dequeue_pos = 0; // only used by the drain thread
+    alignas(64) std::atomic<uint32_t> signal{0};
+    std::atomic<uint64_t> dropped_events{0};
+    Handler handler;
+    // declared last, so it is joined before the ring is destroyed
+    std::jthread drainer;
+
+    bool try_pop(NatsEvent& out) noexcept
+    {
+        Cell& cell = cells[dequeue_pos & mask];
+        size_t seq = cell.sequence.load(std::memory_order_acquire);
+        if (seq != dequeue_pos + 1)
+            return false;
+        out = cell.event;
+        cell.sequence.store(dequeue_pos + mask + 1, std::memory_order_release);
+        ++dequeue_pos;
+        return true;
+    }
+
+    void drain(std::stop_token stop) noexcept
+    {
+        NatsEvent event{};
+        while (true)
+        {
+            uint32_t seen = signal.load(std::memory_order_acquire);
+            while (try_pop(event))
+                handler(event);
+            if (stop.stop_requested())
+                return;
+            signal.wait(seen, std::memory_order_acquire);
+        }
+    }
+
+    static void print(const NatsEvent& event)
+    {
+        std::cerr << event.to_string() << '\n';
+    }
+
+public:
+    /**
+     * Starts the drain thread, `capacity` is rounded up to a power of two.
+     */
+    explicit NatsAsyncEventSink(Handler handler = print, size_t capacity = 1024)
+        : cells(new Cell[std::bit_ceil(capacity < 2 ? size_t(2) : capacity)]),
+          mask(std::bit_ceil(capacity < 2 ? size_t(2) : capacity) - 1),
+          handler(std::move(handler))
+    {
+        for (size_t i = 0; i <= mask; ++i)
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+        drainer = std::jthread([this](std::stop_token stop) { drain(stop); });
+    }
+
+    ~NatsAsyncEventSink() override
+    {
+        drainer.request_stop();
+        signal.fetch_add(1, std::memory_order_release);
+        signal.notify_one();
+    }
+
+    // Disable copy and move, the drain thread refers to this object
+    NatsAsyncEventSink(const NatsAsyncEventSink&) = delete;
+    NatsAsyncEventSink& operator=(const NatsAsyncEventSink&) = delete;
+
+    /**
+     * Sink used by clients without an explicitly set sink.
+     */
+    static NatsAsyncEventSink& instance()
+    {
+        static NatsAsyncEventSink sink;
+        return sink;
+    }
+
+    void on_event(const NatsEvent& event) noexcept override
+    {
+        size_t pos = enqueue_pos.load(std::memory_order_relaxed);
+        while (true)
+        {
+            Cell& cell = cells[pos & mask];
+            size_t seq = cell.sequence.load(std::memory_order_acquire);
+            auto diff = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos);
+            if (diff == 0)
+            {
+                if (enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    cell.event = event;
+                    cell.sequence.store(pos + 1, std::memory_order_release);
+                    break;
+                }
+            }
+            else if (diff < 0)
+            {
+                dropped_events.fetch_add(1, std::memory_order_relaxed);
+                return; // full
+            }
+            else
+            {
+                pos = enqueue_pos.load(std::memory_order_relaxed);
+            }
+        }
+        signal.fetch_add(1, std::memory_order_release);
+        signal.notify_one();
+    }
+
+    /**
+     * Number of events dropped because the ring was full.
+     */
+    uint64_t dropped() const noexcept
+    {
+        return dropped_events.load(std::memory_order_relaxed);
+    }
+};
+} // namespace nats
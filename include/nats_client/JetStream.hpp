@@ -0,0 +1,113 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <functional>
+#include <expected>
+#include <nats/nats.h>
+
+#include "Error.hpp"
+#include "MessageView.hpp"
+
+namespace nats
+{
+using std::string_view;
+using std::expected;
+
+/**
+ * Read-only view of the acknowledgement of a message stored in a stream.
+ */
+struct JsPubAckView
+{
+    const jsPubAck* ptr = nullptr;
+
+    string_view stream() const noexcept
+    {
+        return string_view(ptr->Stream);
+    }
+
+    uint64_t sequence() const noexcept
+    {
+        return ptr->Sequence;
+    }
+
+    string_view domain() const noexcept
+    {
+        return ptr->Domain ? string_view(ptr->Domain) : string_view();
+    }
+
+    /**
+     * True if the stream already had a message with the same message ID.
+     */
+    bool duplicate() const noexcept
+    {
+        return ptr->Duplicate;
+    }
+};
+
+/**
+ * Acknowledgement returned by a synchronous JetStream publish.
+ */
+struct JsPubAck : JsPubAckView
+{
+    JsPubAck(jsPubAck* pa) noexcept //
+        : JsPubAckView{pa}
+    {
+    }
+
+    ~JsPubAck() noexcept
+    {
+        if (ptr)
+        {
+            jsPubAck_Destroy(const_cast<jsPubAck*>(ptr));
+            ptr = nullptr;
+        }
+    }
+
+    // Disable copy
+    JsPubAck(const JsPubAck&) = delete;
+    JsPubAck& operator=(const JsPubAck&) = delete;
+
+    // Enable move
+    JsPubAck(JsPubAck&& other) noexcept : JsPubAckView{other.ptr}
+    {
+        other.ptr = nullptr;
+    }
+    JsPubAck& operator=(JsPubAck&& other) noexcept
+    {
+        if (this != &other)
+        {
+            if (ptr)
+            {
+                jsPubAck_Destroy(const_cast<jsPubAck*>(ptr));
+            }
+            ptr = other.ptr;
+            other.ptr = nullptr;
+        }
+        return *this;
+    }
+};
+
+/**
+ * Called once per asynchronously published message when its acknowledgement (or error)
+ * arrives, on a cnats thread. The ack view is only valid during the call, the message is
+ * owned by the handler and may be moved out, e.g. to publish it again.
+ */
+using JsAckHandler =
+    std::function<void(NatsMessageView& msg, expected<JsPubAckView, NatsError> ack)>;
+
+/**
+ * JetStream context configuration, see `NatsClient::jet_stream`.
+ */
+struct JsConfig
+{
+    // Maximum number of asynchronously published messages awaiting their ack.
+    // `js_publish_async` blocks up to `stall_wait_ms` when the window is full.
+    int64_t max_pending = 256;
+    int64_t stall_wait_ms = 200;
+
+    // Optional, invoked for every ack of `js_publish_async`
+    JsAckHandler ack_handler;
+};
+} // namespace nats
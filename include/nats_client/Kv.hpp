@@ -1,6 +1,8 @@
 #pragma once
 
 #include <cstddef>
+#include <compare>
+#include <iterator>
 #include <string>
 #include <string_view>
 #include <vector>
@@ -286,9 +288,109 @@ struct KvKeysList
         return *this;
     }
 
+    /**
+     * Iterates the keys as views into the list, without copying them.
+     */
+    class iterator
+    {
+    private:
+        char* const* pos = nullptr;
+
+    public:
+        using iterator_category = std::random_access_iterator_tag;
+        using value_type = string_view;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = string_view;
+
+        iterator() noexcept = default;
+        explicit iterator(char* const* p) noexcept //
+            : pos(p)
+        {
+        }
+
+        string_view operator*() const noexcept
+        {
+            return *pos;
+        }
+        string_view operator[](difference_type n) const noexcept
+        {
+            return pos[n];
+        }
+        iterator& operator++() noexcept
+        {
+            ++pos;
+            return *this;
+        }
+        iterator operator++(int) noexcept
+        {
+            return iterator(pos++);
+        }
+        iterator& operator--() noexcept
+        {
+            --pos;
+            return *this;
+        }
+        iterator operator--(int) noexcept
+        {
+            return iterator(pos--);
+        }
+        iterator& operator+=(difference_type n) noexcept
+        {
+            pos += n;
+            return *this;
+        }
+        iterator& operator-=(difference_type n) noexcept
+        {
+            pos -= n;
+            return *this;
+        }
+        friend iterator operator+(iterator it, difference_type n) noexcept
+        {
+            return it += n;
+        }
+        friend iterator operator+(difference_type n, iterator it) noexcept
+        {
+            return it += n;
+        }
+        friend iterator operator-(iterator it, difference_type n) noexcept
+        {
+            return it -= n;
+        }
+        friend difference_type operator-(iterator a, iterator b) noexcept
+        {
+            return a.pos - b.pos;
+        }
+        friend auto operator<=>(iterator a, iterator b) noexcept = default;
+    };
+
+    iterator begin() const noexcept
+    {
+        return iterator(kl.Keys);
+    }
+
+    iterator end() const noexcept
+    {
+        return iterator(kl.Keys + kl.Count);
+    }
+
+    size_t size() const noexcept
+    {
+        return static_cast<size_t>(kl.Count);
+    }
+
+    string_view operator[](size_t i) const noexcept
+    {
+        return kl.Keys[i];
+    }
+
+    /**
+     * Copies the keys, prefer iterating the list directly.
+     */
     vector<string> keys() const noexcept
     {
         vector<string> keys;
+        keys.reserve(size());
         for (int i = 0; i < kl.Count; i++)
             keys.push_back(kl.Keys[i]);
         return keys;
@@ -0,0 +1,138 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <charconv>
+#include <string>
+#include <string_view>
+#include <span>
+#include <expected>
+#include <nats/nats.h>
+
+#include "Error.hpp"
+#include "MessageView.hpp"
+
+// Wire formats used by the pipelined KV operations of `NatsClient`, which bypass
+// the blocking kvStore calls:
+//
+// put: publish to "$KV.<bucket>.<key>", reply is a JSON PubAck {"stream":..,"seq":<revision>}
+//      or {"error":{"code":..,"err_code":..,"description":..}}
+// get: direct get "$JS.API.DIRECT.GET.KV_<bucket>.$KV.<bucket>.<key>", which requires
+//      `AllowDirect` on the bucket's stream (set for buckets created by recent servers and
+//      clients, not for older ones). Reply is the stored message with a "Nats-Sequence"
+//      header, or an empty message with a "Status" header (404 if there is no such key)
+//
+// Keys are put into these subjects as they are, so they are checked with `kv_valid_key`
+// first, as the kvStore calls do.
+
+namespace nats
+{
+using std::string;
+using std::string_view;
+using std::span;
+using std::byte;
+using std::expected;
+using std::unexpected;
+
+/**
+ * Value of a key read by `NatsClient::kv_get_many`, owning the reply message.
+ */
+struct KvValue
+{
+    NatsMessageView msg;
+    uint64_t revision{0};
+
+    span<const byte> value_bytes() const noexcept
+    {
+        return msg.data();
+    }
+
+    string_view value_string() const noexcept
+    {
+        return msg.string();
+    }
+
+    /**
+     * Interprets a direct get reply. A missing, deleted or purged key is reported as
+     * status-only `NATS_NOT_FOUND` error, like `kvStore_Get` does.
+     */
+    static expected<KvValue, NatsError> from_reply(NatsMessageView&& reply) noexcept
+    {
+        auto res_status = reply.header("Status");
+        if (res_status && res_status.value())
+        {
+            if (res_status.value() == "404")
+                return unexpected(NatsError(NATS_NOT_FOUND));
+            auto res_desc = reply.header("Description");
+            string_view desc = "direct get failed";
+            if (res_desc && res_desc.value())
+                desc = res_desc.value().value();
+            return unexpected(NatsError(NATS_ERR, string(desc)));
+        }
+
+        auto res_op = reply.header("KV-Operation");
+        if (res_op && res_op.value())
+            return unexpected(NatsError(NATS_NOT_FOUND)); // DEL or PURGE marker
+
+        auto res_seq = reply.header("Nats-Sequence");
+        if (!res_seq || !res_seq.value())
+            return unexpected(NatsError(NATS_ERR, "Direct get reply without sequence."));
+
+        KvValue v{std::move(reply)};
+        string_view seq = res_seq.value().value();
+        auto [end, ec] = std::from_chars(seq.data(), seq.data() + seq.size(), v.revision);
+        if (ec != std::errc())
+            return unexpected(NatsError(NATS_ERR, "Direct get reply with invalid sequence."));
+        return v;
+    }
+};
+
+/**
+ * Same rules as the kvStore calls: not empty, no leading or trailing `.`, and only
+ * letters, digits and `-/_=.`.
+ */
+inline bool kv_valid_key(string_view key) noexcept
+{
+    if (key.empty() || key.front() == '.' || key.back() == '.')
+        return false;
+    for (char c : key)
+    {
+        bool alnum = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9');
+        if (!alnum && c != '-' && c != '/' && c != '_' && c != '=' && c != '.')
+            return false;
+    }
+    return true;
+}
+
+/**
+ * Interprets the JSON PubAck replied to a KV put, returning the revision of the new value.
+ */
+inline expected<uint64_t, NatsError> kv_parse_put_ack(const NatsMessageView& reply) noexcept
+{
+    string_view json = reply.string();
+
+    auto field = [json](string_view name) -> string_view
+    {
+        size_t pos = json.find(name);
+        if (pos == string_view::npos)
+            return {};
+        return json.substr(pos + name.size());
+    };
+
+    if (field("\"error\"").data())
+    {
+        string_view desc = field("\"description\":\"");
+        desc = desc.substr(0, desc.find('"'));
+        return unexpected(
+            NatsError(NATS_ERR, string(desc.empty() ? string_view("KV put failed") : desc))
+        );
+    }
+
+    string_view seq = field("\"seq\":");
+    uint64_t revision = 0;
+    auto [end, ec] = std::from_chars(seq.data(), seq.data() + seq.size(), revision);
+    if (seq.empty() || ec != std::errc())
+        return unexpected(NatsError(NATS_ERR, "KV put reply without sequence."));
+    return revision;
+}
+} // namespace nats
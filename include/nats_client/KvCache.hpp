@@ -0,0 +1,257 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <expected>
+#include <nats/nats.h>
+
+#include "Error.hpp"
+#include "Kv.hpp"
+
+namespace nats
+{
+using std::string;
+using std::string_view;
+using std::span;
+using std::byte;
+using std::expected;
+using std::unexpected;
+
+/**
+ * Immutable copy of a KV entry held by `KvCache`.
+ */
+struct KvCachedEntry
+{
+    vector<byte> value;
+    uint64_t revision;
+
+    span<const byte> value_bytes() const noexcept
+    {
+        return value;
+    }
+
+    string_view value_string() const noexcept
+    {
+        return string_view(reinterpret_cast<const char*>(value.data()), value.size());
+    }
+};
+
+/**
+ * Local read-through copy of the keys of a bucket, kept up to date by a `KvWatcher`.
+ *
+ * `create` loads the initial state of the watcher before returning, then a background thread
+ * applies updates as they arrive, ordered by revision. `get` is served from memory: a shared
+ * lock on one of the shards of the map and a reference count increment, no round trip.
+ * Reads see updates with the watcher's propagation delay.
+ *
+ * Keys not covered by the watched key filter are never present in the cache.
+ */
+class KvCache
+{
+public:
+    using Entry = std::shared_ptr<const KvCachedEntry>;
+
+private:
+    static constexpr size_t shard_count = 64;
+    static constexpr int64_t poll_timeout_ms = 100;
+
+    struct Hash
+    {
+        using is_transparent = void;
+        size_t operator()(string_view key) const noexcept
+        {
+            return std::hash<string_view>{}(key);
+        }
+    };
+
+    struct alignas(64) Shard
+    {
+        std::shared_mutex mu;
+        std::unordered_map<string, Entry, Hash, std::equal_to<>> entries;
+    };
+
+    struct State
+    {
+        Shard shards[shard_count];
+        KvWatcher watcher;
+        // NATS_OK while the watcher delivers updates, otherwise the status it failed with
+        std::atomic<natsStatus> status{NATS_OK};
+
+        State(KvWatcher&& w) noexcept //
+            : watcher(std::move(w))
+        {
+        }
+
+        Shard& shard(size_t hash) noexcept
+        {
+            // the low bits select the bucket within the shard's map
+            return shards[(hash >> 16) % shard_count];
+        }
+
+        void apply(const KvEntry& e) noexcept
+        {
+            string_view key = e.key();
+            size_t hash = Hash{}(key);
+            Shard& sh = shard(hash);
+            kvOperation op = e.operation();
+
+            Entry entry;
+            if (op == kvOp_Put)
+            {
+                span<const byte> v = e.value_bytes();
+                entry = std::make_shared<const KvCachedEntry>(
+                    KvCachedEntry{vector<byte>(v.begin(), v.end()), e.revision()}
+                );
+            }
+
+            std::unique_lock<std::shared_mutex> lock(sh.mu);
+            auto it = sh.entries.find(key);
+            if (it != sh.entries.end() && it->second->revision >= e.revision())
+                return; // stale
+            if (op != kvOp_Put)
+            {
+                if (it != sh.entries.end())
+                    sh.entries.erase(it);
+                return;
+            }
+            if (it != sh.entries.end())
+                it->second = std::move(entry);
+            else
+                sh.entries.emplace(string(key), std::move(entry));
+        }
+
+        void run(std::stop_token stop) noexcept
+        {
+            while (!stop.stop_requested())
+            {
+                auto res = watcher.next(poll_timeout_ms);
+                if (!res)
+                {
+                    if (res.error().status == NATS_TIMEOUT)
+                        continue;
+                    status.store(res.error().status, std::memory_order_release);
+                    return;
+                }
+                if (!res.value())
+                    continue; // end of initial state, already seen by create
+                apply(res.value().value());
+            }
+        }
+    };
+
+    // heap allocated, the update thread keeps referring to it when the cache is moved
+    std::unique_ptr<State> state;
+    std::jthread updater;
+
+    KvCache(std::unique_ptr<State> st) noexcept //
+        : state(std::move(st))
+    {
+        updater = std::jthread([s = state.get()](std::stop_token stop) { s->run(stop); });
+    }
+
+    void cleanup() noexcept
+    {
+        if (state)
+        {
+            updater.request_stop();
+            (void)state->watcher.stop();
+            updater.join();
+            state = nullptr;
+        }
+    }
+
+public:
+    /**
+     * Loads the initial state of `watcher` (e.g. from `NatsClient::kvs_watch`), waiting up to
+     * `timeout_ms` for each entry, and starts applying its updates in the background.
+     */
+    static expected<KvCache, NatsError> create(
+        KvWatcher&& watcher, int64_t timeout_ms
+    ) noexcept
+    {
+        auto st = std::make_unique<State>(std::move(watcher));
+        while (true)
+        {
+            auto res = st->watcher.next(timeout_ms);
+            if (!res)
+                return unexpected(res.error());
+            if (!res.value())
+                break; // initial state loaded
+            st->apply(res.value().value());
+        }
+        return KvCache(std::move(st));
+    }
+
+    ~KvCache()
+    {
+        cleanup();
+    }
+
+    // Disable copy
+    KvCache(const KvCache&) = delete;
+    KvCache& operator=(const KvCache&) = delete;
+
+    // Enable move
+    KvCache(KvCache&& other) noexcept = default;
+    KvCache& operator=(KvCache&& other) noexcept
+    {
+        if (this != &other)
+        {
+            cleanup();
+            state = std::move(other.state);
+            updater = std::move(other.updater);
+        }
+        return *this;
+    }
+
+    /**
+     * Latest known entry for the key, `nullptr` if the key does not exist (or was deleted).
+     * The returned entry stays valid after later updates of the key.
+     */
+    Entry get(string_view key) const noexcept
+    {
+        Shard& sh = state->shard(Hash{}(key));
+        std::shared_lock<std::shared_mutex> lock(sh.mu);
+        auto it = sh.entries.find(key);
+        if (it == sh.entries.end())
+            return nullptr;
+        return it->second;
+    }
+
+    /**
+     * Number of cached keys.
+     */
+    size_t size() const noexcept
+    {
+        size_t n = 0;
+        for (Shard& sh : state->shards)
+        {
+            std::shared_lock<std::shared_mutex> lock(sh.mu);
+            n += sh.entries.size();
+        }
+        return n;
+    }
+
+    /**
+     * Returns `NATS_OK` while updates are applied. Otherwise the watcher has failed and the
+     * cache keeps serving the entries it had, which may be stale.
+     */
+    natsStatus status() const noexcept
+    {
+        return state->status.load(std::memory_order_acquire);
+    }
+};
+} // namespace nats
@@ -0,0 +1,151 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <span>
+#include <vector>
+#include <expected>
+#include <format>
+#include <nats/nats.h>
+
+#include "Error.hpp"
+#include "MessageView.hpp"
+
+namespace nats
+{
+using std::string;
+using std::string_view;
+using std::span;
+using std::byte;
+using std::vector;
+using std::expected;
+using std::unexpected;
+
+/**
+ * Reusable builder for outgoing messages with headers.
+ *
+ * Subject, header keys and values are copied into buffers owned by the builder,
+ * so they don't need to be NUL-terminated or outlive the builder calls.
+ * The payload is borrowed and must outlive `build` or `NatsClient::publish`.
+ *
+ * Calling `clear` keeps the allocated capacity, so a builder can be reused
+ * without allocating per header field in steady state.
+ */
+class NatsMessageBuilder
+{
+private:
+    struct Field
+    {
+        size_t key;
+        size_t value;
+        bool append;
+    };
+
+    string subject_buf;
+    span<const byte> payload;
+    // NUL-terminated keys and values, referenced by offset since the buffer may grow
+    vector<char> arena;
+    vector<Field> fields;
+
+    size_t push(string_view str)
+    {
+        size_t offset = arena.size();
+        arena.insert(arena.end(), str.begin(), str.end());
+        arena.push_back('\0');
+        return offset;
+    }
+
+public:
+    NatsMessageBuilder& set_subject(string_view subject)
+    {
+        subject_buf.assign(subject);
+        return *this;
+    }
+
+    NatsMessageBuilder& set_data(span<const byte> data) noexcept
+    {
+        payload = data;
+        return *this;
+    }
+
+    NatsMessageBuilder& set_data(string_view data) noexcept
+    {
+        payload = span<const byte>{reinterpret_cast<const byte*>(data.data()), data.size()};
+        return *this;
+    }
+
+    /**
+     * Sets the header `key` to `value`, replacing previous values of the same key.
+     */
+    NatsMessageBuilder& set_header(string_view key, string_view value)
+    {
+        size_t k = push(key);
+        fields.push_back(Field{k, push(value), false});
+        return *this;
+    }
+
+    /**
+     * Adds `value` to the values of header `key`.
+     */
+    NatsMessageBuilder& add_header(string_view key, string_view value)
+    {
+        size_t k = push(key);
+        fields.push_back(Field{k, push(value), true});
+        return *this;
+    }
+
+    /**
+     * Removes subject, data and headers, keeping the allocated capacity.
+     */
+    void clear() noexcept
+    {
+        subject_buf.clear();
+        payload = {};
+        arena.clear();
+        fields.clear();
+    }
+
+    string_view subject() const noexcept
+    {
+        return subject_buf;
+    }
+
+    /**
+     * Creates the NATS message with all headers set.
+     */
+    expected<NatsMessageView, NatsError> build() const noexcept
+    {
+        natsMsg* msg = nullptr;
+        natsStatus s = natsMsg_Create(
+            &msg,
+            subject_buf.c_str(),
+            NULL,
+            reinterpret_cast<const char*>(payload.data()),
+            static_cast<int>(payload.size())
+        );
+        if (s != NATS_OK)
+        {
+            return unexpected(NatsError(
+                s, std::format("Failed to create message for subject [{}].", subject_buf)
+            ));
+        }
+        NatsMessageView view(msg);
+
+        for (const Field& f : fields)
+        {
+            const char* key = arena.data() + f.key;
+            const char* value = arena.data() + f.value;
+            s = f.append ? natsMsgHeader_Add(msg, key, value) : natsMsgHeader_Set(msg, key, value);
+            if (s != NATS_OK)
+            {
+                return unexpected(
+                    NatsError(s, std::format("Failed to set message header [{}].", key))
+                );
+            }
+        }
+        return view;
+    }
+};
+} // namespace nats
@@ -1,22 +1,37 @@
 #pragma once
 
 #include <cstddef>
+#include <cstdlib>
 #include <string>
 #include <string_view>
 #include <span>
+#include <optional>
+#include <expected>
+#include <format>
 #include <nats/nats.h>
 
+#include "Error.hpp"
+#include "Codec.hpp"
+
 namespace nats
 {
 using std::string;
 using std::string_view;
 using std::span;
 using std::byte;
+using std::optional;
+using std::expected;
+using std::unexpected;
 
 struct NatsMessageView
 {
     natsMsg* ptr{nullptr};
 
+    /**
+     * Creates an empty view, e.g. as slot for `NatsSubscriptionSync::next_msgs`.
+     */
+    NatsMessageView() noexcept = default;
+
     NatsMessageView(natsMsg* msg) noexcept //
         : ptr(msg)
     {
@@ -75,6 +90,125 @@ struct NatsMessageView
     {
         return natsMsg_GetDataLength(ptr);
     }
+
+    /**
+     * Decodes the payload with `NatsCodec<T>`, e.g. a number copied out of the payload.
+     * Views returned by a codec point into the message and are valid as long as the message.
+     */
+    template <NatsDecodable T>
+    auto as() const noexcept
+    {
+        return NatsCodec<T>::decode(data());
+    }
+
+    /**
+     * Returns the first value of the header `key` (NUL-terminated),
+     * or `std::nullopt` if the message has no such header.
+     *
+     * The value points into the message and is valid as long as the message.
+     */
+    expected<optional<string_view>, NatsError> header(string_view key) const noexcept
+    {
+        const char* value = nullptr;
+        natsStatus s = natsMsgHeader_Get(ptr, key.data(), &value);
+        if (s == NATS_NOT_FOUND)
+            return std::nullopt;
+        if (s != NATS_OK)
+            return unexpected(NatsError(s, std::format("Failed to get message header [{}].", key)));
+        return string_view(value);
+    }
+
+    /**
+     * Writes the values of the header `key` (NUL-terminated) into `out`
+     * and returns the total number of values, which may exceed `out.size()`.
+     *
+     * The values point into the message and are valid as long as the message.
+     */
+    expected<size_t, NatsError> header_values(string_view key, span<string_view> out) const noexcept
+    {
+        const char** values = nullptr;
+        int count = 0;
+        natsStatus s = natsMsgHeader_Values(ptr, key.data(), &values, &count);
+        if (s == NATS_NOT_FOUND)
+            return 0;
+        if (s != NATS_OK)
+        {
+            return unexpected(
+                NatsError(s, std::format("Failed to get message header values [{}].", key))
+            );
+        }
+        size_t n = static_cast<size_t>(count);
+        for (size_t i = 0; i < n && i < out.size(); ++i)
+            out[i] = values[i];
+        std::free(values); // only the array is owned by the caller
+        return n;
+    }
+
+    /**
+     * Writes the header keys into `out` and returns the total number of keys,
+     * which may exceed `out.size()`.
+     *
+     * The keys point into the message and are valid as long as the message.
+     */
+    expected<size_t, NatsError> header_keys(span<string_view> out) const noexcept
+    {
+        const char** keys = nullptr;
+        int count = 0;
+        natsStatus s = natsMsgHeader_Keys(ptr, &keys, &count);
+        if (s == NATS_NOT_FOUND)
+            return 0;
+        if (s != NATS_OK)
+            return unexpected(NatsError(s, "Failed to get message header keys."));
+        size_t n = static_cast<size_t>(count);
+        for (size_t i = 0; i < n && i < out.size(); ++i)
+            out[i] = keys[i];
+        std::free(keys); // only the array is owned by the caller
+        return n;
+    }
+
+    /**
+     * Acknowledges a JetStream message, without waiting for the server to confirm.
+     */
+    expected<void, NatsError> ack() const noexcept
+    {
+        natsStatus s = natsMsg_Ack(ptr, NULL);
+        if (s != NATS_OK)
+            return unexpected(NatsError(s, "Failed to ack message."));
+        return {}; // Success
+    }
+
+    /**
+     * Negatively acknowledges a JetStream message, so that it is redelivered.
+     */
+    expected<void, NatsError> nak() const noexcept
+    {
+        natsStatus s = natsMsg_Nak(ptr, NULL);
+        if (s != NATS_OK)
+            return unexpected(NatsError(s, "Failed to nak message."));
+        return {}; // Success
+    }
+
+    /**
+     * Resets the redelivery timer of a JetStream message which is still being processed.
+     */
+    expected<void, NatsError> in_progress() const noexcept
+    {
+        natsStatus s = natsMsg_InProgress(ptr, NULL);
+        if (s != NATS_OK)
+            return unexpected(NatsError(s, "Failed to mark message in progress."));
+        return {}; // Success
+    }
+
+    /**
+     * Terminates the delivery of a JetStream message, it is not redelivered.
+     */
+    expected<void, NatsError> term() const noexcept
+    {
+        natsStatus s = natsMsg_Term(ptr, NULL);
+        if (s != NATS_OK)
+            return unexpected(NatsError(s, "Failed to term message."));
+        return {}; // Success
+    }
 };
 
 } // namespace nats
@@ -6,6 +6,7 @@
 #include <string_view>
 #include <vector>
 #include <memory>
+#include <concepts>
 #include <nats/nats.h>
 
 // Regex: ^natsOptions_[a-zA-Z0-9_]+
@@ -47,7 +48,7 @@
 // natsOptions_SetDiscoveredServersCB
 // natsOptions_SetLameDuckModeCB
 // natsOptions_SetIgnoreDiscoveredServers
-// natsOptions_SetEventLoop
+// OK natsOptions_SetEventLoop
 // OK natsOptions_UseGlobalMessageDelivery
 // OK natsOptions_IPResolutionOrder
 // OK natsOptions_SetSendAsap
@@ -72,10 +73,23 @@ using std::string;
 using std::string_view;
 using std::vector;
 
+/**
+ * Event loop that can drive the socket I/O of connections, see `NatsEpollLoop`.
+ */
+template <typename Loop>
+concept NatsEventLoop = requires {
+    { &Loop::attach } -> std::convertible_to<natsEvLoop_Attach>;
+    { &Loop::read } -> std::convertible_to<natsEvLoop_ReadAddRemove>;
+    { &Loop::write } -> std::convertible_to<natsEvLoop_WriteAddRemove>;
+    { &Loop::detach } -> std::convertible_to<natsEvLoop_Detach>;
+};
+
 struct NatsOptions
 {
     natsOptions* ptr = nullptr;
     natsStatus s;
+    // kept for labeling the connection, e.g. in `NatsMetricsRegistry`
+    string name;
 
     NatsOptions(natsOptions* opts) noexcept //
         : ptr(opts)
@@ -96,7 +110,8 @@ struct NatsOptions
     NatsOptions& operator=(const NatsOptions&) = delete;
 
     // Allow moving
-    NatsOptions(NatsOptions&& other) noexcept : ptr(other.ptr), s(other.s)
+    NatsOptions(NatsOptions&& other) noexcept
+        : ptr(other.ptr), s(other.s), name(std::move(other.name))
     {
         other.ptr = nullptr;
     }
@@ -111,6 +126,7 @@ struct NatsOptions
             }
             ptr = other.ptr;
             s = other.s;
+            name = std::move(other.name);
             other.ptr = nullptr;
         }
         return *this;
@@ -138,6 +154,7 @@ struct NatsOptions
     NatsOptions& set_name(string_view name) noexcept
     {
         s = natsOptions_SetName(ptr, name.data());
+        this->name = name;
         return *this;
     }
 
@@ -328,6 +345,29 @@ struct NatsOptions
         return *this;
     }
 
+    /**
+     * Makes the connection use an external event loop instead of its own reader
+     * and flusher threads. The loop must outlive the connection, which must be closed
+     * and destroyed on the loop thread.
+     */
+    NatsOptions& set_event_loop(
+        void* loop,
+        natsEvLoop_Attach attach,
+        natsEvLoop_ReadAddRemove read,
+        natsEvLoop_WriteAddRemove write,
+        natsEvLoop_Detach detach
+    ) noexcept
+    {
+        s = natsOptions_SetEventLoop(ptr, loop, attach, read, write, detach);
+        return *this;
+    }
+
+    template <NatsEventLoop Loop>
+    NatsOptions& set_event_loop(Loop& loop) noexcept
+    {
+        return set_event_loop(&loop, &Loop::attach, &Loop::read, &Loop::write, &Loop::detach);
+    }
+
     NatsOptions& set_user_info(string_view username, string_view password) noexcept
     {
         s = natsOptions_SetUserInfo(ptr, username.data(), password.data());
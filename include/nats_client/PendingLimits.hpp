@@ -0,0 +1,259 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <condition_variable>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+#include <expected>
+#include <format>
+#include <nats/nats.h>
+
+#include "Error.hpp"
+
+namespace nats
+{
+using std::expected;
+using std::unexpected;
+using std::optional;
+using std::vector;
+
+/**
+ * Process-wide tuner of subscription pending limits, sharing one memory budget.
+ *
+ * Registered subscriptions start at a small limit. A background thread samples their
+ * pending counts and doubles the limits of subscriptions whose backlog fills up (or keeps
+ * growing past half of the limit), before cnats starts dropping messages. The bytes limits
+ * of all subscriptions together never exceed the budget. Limits of subscriptions that stay
+ * mostly empty are halved again over time, back to their initial value, returning budget.
+ *
+ * High-water marks are tracked by cnats, see `NatsSubscriptionStats::max_pending_bytes`.
+ * Subscriptions register with `set_adaptive_pending_limits`.
+ */
+class NatsPendingTuner
+{
+public:
+    struct Config
+    {
+        // shared by the bytes limits of all registered subscriptions
+        int64_t budget_bytes = 1LL << 30;
+        std::chrono::milliseconds interval{100};
+        // consecutive mostly empty samples before a limit is halved
+        int shrink_after = 50;
+    };
+
+    struct Limits
+    {
+        int msgs{0};
+        int bytes{0};
+        // growths refused because the budget was exhausted
+        uint64_t budget_denied{0};
+    };
+
+private:
+    struct Entry
+    {
+        natsSubscription* sub;
+        int min_msgs;
+        int min_bytes;
+        Limits limits;
+        int last_pending_bytes = 0;
+        int idle_samples = 0;
+    };
+
+    std::mutex mu;
+    std::condition_variable_any wake;
+    Config config;
+    vector<Entry> entries;
+    int64_t reserved_bytes = 0;
+    // started with the first registration
+    std::jthread sampler;
+
+    NatsPendingTuner() noexcept = default;
+
+    static int doubled(int value) noexcept
+    {
+        return value > INT_MAX / 2 ? INT_MAX : value * 2;
+    }
+
+    void apply(Entry& e, int msgs, int bytes) noexcept
+    {
+        if (natsSubscription_SetPendingLimits(e.sub, msgs, bytes) != NATS_OK)
+            return; // closed, removed by its owner soon
+        reserved_bytes += static_cast<int64_t>(bytes) - e.limits.bytes;
+        e.limits.msgs = msgs;
+        e.limits.bytes = bytes;
+    }
+
+    void tune(Entry& e) noexcept
+    {
+        int pending_msgs = 0, pending_bytes = 0;
+        if (natsSubscription_GetPending(e.sub, &pending_msgs, &pending_bytes) != NATS_OK)
+            return;
+
+        bool rising = pending_bytes > e.last_pending_bytes;
+        e.last_pending_bytes = pending_bytes;
+
+        auto filling = [rising](int64_t pending, int64_t limit)
+        { return pending * 4 >= limit * 3 || (rising && pending * 2 >= limit); };
+
+        bool grow_bytes = filling(pending_bytes, e.limits.bytes);
+        bool grow_msgs = filling(pending_msgs, e.limits.msgs);
+        if (grow_bytes || grow_msgs)
+        {
+            e.idle_samples = 0;
+            int msgs = grow_msgs ? doubled(e.limits.msgs) : e.limits.msgs;
+            int bytes = e.limits.bytes;
+            if (grow_bytes)
+            {
+                int64_t left = config.budget_bytes - reserved_bytes;
+                int64_t wanted = doubled(e.limits.bytes) - e.limits.bytes;
+                bytes += static_cast<int>(std::clamp<int64_t>(wanted, 0, std::max<int64_t>(left, 0))
+                );
+                if (bytes == e.limits.bytes)
+                    ++e.limits.budget_denied;
+            }
+            if (msgs != e.limits.msgs || bytes != e.limits.bytes)
+                apply(e, msgs, bytes);
+            return;
+        }
+
+        // mostly empty: less than 1/8 of both limits in use
+        if (pending_bytes * 8 < e.limits.bytes && pending_msgs * 8 < e.limits.msgs &&
+            (e.limits.bytes > e.min_bytes || e.limits.msgs > e.min_msgs))
+        {
+            if (++e.idle_samples >= config.shrink_after)
+            {
+                e.idle_samples = 0;
+                int msgs = std::max(e.limits.msgs / 2, e.min_msgs);
+                apply(e, msgs, std::max(e.limits.bytes / 2, e.min_bytes));
+            }
+            return;
+        }
+        e.idle_samples = 0;
+    }
+
+    void run(std::stop_token stop) noexcept
+    {
+        std::unique_lock<std::mutex> lock(mu);
+        while (!stop.stop_requested())
+        {
+            for (Entry& e : entries)
+                tune(e);
+            wake.wait_for(lock, stop, config.interval, []() { return false; });
+        }
+    }
+
+public:
+    // Disable copy and move
+    NatsPendingTuner(const NatsPendingTuner&) = delete;
+    NatsPendingTuner& operator=(const NatsPendingTuner&) = delete;
+
+    static NatsPendingTuner& instance() noexcept
+    {
+        static NatsPendingTuner tuner;
+        return tuner;
+    }
+
+    /**
+     * Changes the budget and sampling settings, applied from the next sample on.
+     * A smaller budget does not shrink limits already granted.
+     */
+    void configure(const Config& cfg) noexcept
+    {
+        std::lock_guard<std::mutex> lock(mu);
+        config = cfg;
+    }
+
+    /**
+     * Registers a subscription, starting at the given limits which are reserved from the budget.
+     * Fails with `NATS_INVALID_ARG` unless both minimums are positive, and with
+     * `NATS_INSUFFICIENT_BUFFER` if the budget cannot cover them.
+     */
+    expected<void, NatsError> add(natsSubscription* sub, int min_msgs, int min_bytes) noexcept
+    {
+        // cnats takes negative limits as unlimited and rejects zero, neither can be scaled,
+        // and a negative minimum would shrink the reserved budget
+        if (min_msgs <= 0 || min_bytes <= 0)
+        {
+            return unexpected(NatsError(
+                NATS_INVALID_ARG,
+                std::format(
+                    "Adaptive pending limits need positive minimums, got {} messages and {} bytes.",
+                    min_msgs,
+                    min_bytes
+                )
+            ));
+        }
+
+        std::lock_guard<std::mutex> lock(mu);
+        if (reserved_bytes + min_bytes > config.budget_bytes)
+        {
+            return unexpected(NatsError(
+                NATS_INSUFFICIENT_BUFFER,
+                std::format(
+                    "Pending limits budget of {} bytes exhausted, {} bytes reserved.",
+                    config.budget_bytes,
+                    reserved_bytes
+                )
+            ));
+        }
+
+        natsStatus s = natsSubscription_SetPendingLimits(sub, min_msgs, min_bytes);
+        if (s != NATS_OK)
+            return unexpected(NatsError(s, "Failed to set initial pending limits."));
+
+        entries.push_back(Entry{sub, min_msgs, min_bytes, Limits{min_msgs, min_bytes}});
+        reserved_bytes += min_bytes;
+
+        if (!sampler.joinable())
+            sampler = std::jthread([this](std::stop_token stop) { run(stop); });
+        return {}; // Success
+    }
+
+    /**
+     * Unregisters a subscription and returns its bytes limit to the budget.
+     * Once this returns, the tuner no longer accesses the subscription.
+     */
+    void remove(natsSubscription* sub) noexcept
+    {
+        std::lock_guard<std::mutex> lock(mu);
+        auto it = std::find_if(
+            entries.begin(), entries.end(), [sub](const Entry& e) { return e.sub == sub; }
+        );
+        if (it == entries.end())
+            return;
+        reserved_bytes -= it->limits.bytes;
+        *it = entries.back();
+        entries.pop_back();
+    }
+
+    /**
+     * Current limits of a registered subscription.
+     */
+    optional<Limits> limits(natsSubscription* sub) noexcept
+    {
+        std::lock_guard<std::mutex> lock(mu);
+        for (const Entry& e : entries)
+        {
+            if (e.sub == sub)
+                return e.limits;
+        }
+        return std::nullopt;
+    }
+
+    /**
+     * Bytes of the budget currently granted to subscriptions.
+     */
+    int64_t reserved() noexcept
+    {
+        std::lock_guard<std::mutex> lock(mu);
+        return reserved_bytes;
+    }
+};
+} // namespace nats
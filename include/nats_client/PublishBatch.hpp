@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstddef>
+#include <string_view>
+#include <span>
+#include <vector>
+
+namespace nats
+{
+using std::string_view;
+using std::span;
+using std::byte;
+using std::vector;
+
+/**
+ * Single message of a batch publish.
+ *
+ * The subject needs to be NUL-terminated, like for `NatsClient::publish`.
+ * Subject and data are borrowed and must outlive the publish call.
+ */
+struct PublishItem
+{
+    string_view subject;
+    span<const byte> data;
+};
+
+/**
+ * Reusable builder for batch publishes.
+ *
+ * Calling `clear` keeps the allocated capacity, so a batch can be filled
+ * and published repeatedly without allocating in steady state.
+ */
+class PublishBatch
+{
+private:
+    vector<PublishItem> entries;
+
+public:
+    PublishBatch() noexcept = default;
+
+    explicit PublishBatch(size_t capacity)
+    {
+        entries.reserve(capacity);
+    }
+
+    PublishBatch& add(string_view subject, span<const byte> data)
+    {
+        entries.push_back(PublishItem{subject, data});
+        return *this;
+    }
+
+    PublishBatch& add(string_view subject, string_view data)
+    {
+        span<const byte> bytes{reinterpret_cast<const byte*>(data.data()), data.size()};
+        entries.push_back(PublishItem{subject, bytes});
+        return *this;
+    }
+
+    void clear() noexcept
+    {
+        entries.clear();
+    }
+
+    size_t size() const noexcept
+    {
+        return entries.size();
+    }
+
+    bool empty() const noexcept
+    {
+        return entries.empty();
+    }
+
+    span<const PublishItem> items() const noexcept
+    {
+        return entries;
+    }
+};
+} // namespace nats
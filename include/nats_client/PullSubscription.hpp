@@ -0,0 +1,321 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+#include <memory>
+#include <utility>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <expected>
+#include <format>
+#include <nats/nats.h>
+
+#include "Error.hpp"
+#include "MessageView.hpp"
+
+namespace nats
+{
+using std::span;
+using std::vector;
+using std::expected;
+using std::unexpected;
+
+class NatsClient;
+
+/**
+ * JetStream pull consumer, messages are requested in batches with `fetch`.
+ *
+ * Created by `NatsClient::js_pull_subscribe`. The subscription owns the messages of the
+ * returned batch, they are released by the next fetch (or can be moved out before).
+ */
+class JsPullSubscription
+{
+private:
+    friend class NatsClient;
+
+    // Background fetcher of `fetch_ahead`, heap allocated so the subscription stays movable
+    struct Prefetch
+    {
+        natsSubscription* sub;
+        std::mutex mu;
+        std::condition_variable_any cv;
+        jsFetchRequest req{};
+        bool requested = false;
+        bool ready = false;
+        natsStatus status = NATS_OK;
+        vector<NatsMessageView> msgs;
+        // declared last, so it is joined before the rest is destroyed
+        std::jthread worker;
+
+        explicit Prefetch(natsSubscription* sub) noexcept : sub(sub)
+        {
+        }
+
+        void run(std::stop_token stop) noexcept
+        {
+            std::unique_lock<std::mutex> lock(mu);
+            while (cv.wait(lock, stop, [this]() { return requested; }))
+            {
+                jsFetchRequest r = req;
+                lock.unlock();
+                // `msgs` is not touched by the consumer while a fetch is requested
+                natsStatus st = fetch_into(sub, r, msgs);
+                lock.lock();
+                status = st;
+                requested = false;
+                ready = true;
+                cv.notify_all();
+            }
+        }
+    };
+
+    vector<NatsMessageView> batch;
+    std::unique_ptr<Prefetch> prefetch;
+    // Error of a fetch that still returned messages, reported by the next call
+    // instead of being lost.
+    natsStatus deferred_status = NATS_OK;
+
+    JsPullSubscription(natsSubscription* sub) noexcept //
+        : ptr(sub)
+    {
+    }
+
+    static jsFetchRequest make_request(int batch_size, int64_t max_bytes, int64_t expires_ms)
+        noexcept
+    {
+        jsFetchRequest req;
+        jsFetchRequest_Init(&req);
+        req.Batch = batch_size;
+        req.MaxBytes = max_bytes;
+        req.Expires = expires_ms * 1'000'000; // in nanoseconds
+        return req;
+    }
+
+    /**
+     * Fetches a batch into `out`, reusing its capacity. A fetch which expires is not an
+     * error, `out` is just empty or short. Other errors are returned even if `out` holds
+     * the messages received before, see `take_status`.
+     */
+    static natsStatus fetch_into(
+        natsSubscription* sub, jsFetchRequest& req, vector<NatsMessageView>& out
+    ) noexcept
+    {
+        out.clear(); // releases the previous batch
+
+        natsMsgList list{};
+        natsStatus st = natsSubscription_FetchRequest(&list, sub, &req);
+        for (int i = 0; i < list.Count; ++i)
+        {
+            out.emplace_back(list.Msgs[i]);
+            list.Msgs[i] = NULL; // owned by `out` now
+        }
+        natsMsgList_Destroy(&list);
+
+        if (st == NATS_TIMEOUT)
+            return NATS_OK;
+        return st;
+    }
+
+    /**
+     * Status to report for a fetch that returned `st` with `batch`: an error is deferred
+     * to the next call if messages arrived, so that they are not lost.
+     */
+    natsStatus take_status(natsStatus st) noexcept
+    {
+        if (st != NATS_OK && !batch.empty())
+        {
+            deferred_status = st;
+            return NATS_OK;
+        }
+        return st;
+    }
+
+    /**
+     * Reports an error deferred by the previous fetch, once.
+     */
+    expected<void, NatsError> check_deferred(int batch_size) noexcept
+    {
+        if (deferred_status == NATS_OK)
+            return {}; // Success
+        s = std::exchange(deferred_status, NATS_OK);
+        return unexpected(NatsError(
+            s, std::format("Failed to fetch {} messages from [{}].", batch_size, subject())
+        ));
+    }
+
+public:
+    natsSubscription* ptr;
+    natsStatus s;
+
+    ~JsPullSubscription()
+    {
+        // waits for a fetch still in flight, at most until it expires
+        prefetch.reset();
+
+        if (ptr)
+        {
+            natsSubscription_Destroy(ptr);
+            ptr = nullptr;
+        }
+    }
+
+    // Disable copy
+    JsPullSubscription(const JsPullSubscription&) = delete;
+    JsPullSubscription& operator=(const JsPullSubscription&) = delete;
+
+    // Enable move
+    JsPullSubscription(JsPullSubscription&& other) noexcept
+        : batch(std::move(other.batch)),
+          prefetch(std::move(other.prefetch)),
+          deferred_status(other.deferred_status),
+          ptr(other.ptr)
+    {
+        other.ptr = nullptr;
+    }
+    JsPullSubscription& operator=(JsPullSubscription&& other) noexcept
+    {
+        if (this != &other)
+        {
+            prefetch.reset();
+            if (ptr)
+            {
+                natsSubscription_Destroy(ptr);
+            }
+            batch = std::move(other.batch);
+            prefetch = std::move(other.prefetch);
+            deferred_status = other.deferred_status;
+            ptr = other.ptr;
+            other.ptr = nullptr;
+        }
+        return *this;
+    }
+
+    /**
+     * Requests up to `batch_size` messages (and at most `max_bytes` if not 0) and waits
+     * until the batch is complete or the request expires after `expires_ms`.
+     *
+     * Returns the messages received, possibly none. The span is valid until the next fetch.
+     * If an error occurs after some messages were received, these messages are returned
+     * and the error is reported by the next call.
+     */
+    expected<span<NatsMessageView>, NatsError> fetch(
+        int batch_size, int64_t max_bytes, int64_t expires_ms
+    ) noexcept
+    {
+        if (prefetch)
+        {
+            return unexpected(NatsError(
+                NATS_ILLEGAL_STATE, "Fetches are pipelined, use `fetch_ahead` for the next batch."
+            ));
+        }
+
+        auto res = check_deferred(batch_size);
+        if (!res)
+            return unexpected(res.error());
+
+        jsFetchRequest req = make_request(batch_size, max_bytes, expires_ms);
+        if ((s = take_status(fetch_into(ptr, req, batch))) != NATS_OK)
+        {
+            return unexpected(NatsError(
+                s, std::format("Failed to fetch {} messages from [{}].", batch_size, subject())
+            ));
+        }
+        return span<NatsMessageView>(batch);
+    }
+
+    /**
+     * Like `fetch`, but requests the next batch in the background before returning,
+     * so that it is in flight while the current batch is processed.
+     *
+     * The first call fetches synchronously. The batch returned by a later call was
+     * requested with the arguments of the previous call. Once used, `fetch` is no longer
+     * available for this subscription, and destroying it waits for the request in flight.
+     */
+    expected<span<NatsMessageView>, NatsError> fetch_ahead(
+        int batch_size, int64_t max_bytes, int64_t expires_ms
+    ) noexcept
+    {
+        auto res = check_deferred(batch_size);
+        if (!res)
+            return unexpected(res.error());
+
+        jsFetchRequest req = make_request(batch_size, max_bytes, expires_ms);
+        if (!prefetch)
+        {
+            prefetch = std::make_unique<Prefetch>(ptr);
+            Prefetch* p = prefetch.get();
+            p->worker = std::jthread([p](std::stop_token stop) { p->run(stop); });
+        }
+
+        Prefetch& p = *prefetch;
+        std::unique_lock<std::mutex> lock(p.mu);
+        if (!p.requested && !p.ready)
+        {
+            p.req = req;
+            p.requested = true;
+            p.cv.notify_all();
+        }
+        p.cv.wait(lock, [&p]() { return p.ready; });
+        p.ready = false;
+        batch.swap(p.msgs);
+        s = take_status(p.status);
+
+        // keep the next fetch in flight
+        p.req = req;
+        p.requested = true;
+        lock.unlock();
+        p.cv.notify_all();
+
+        if (s != NATS_OK)
+        {
+            return unexpected(NatsError(
+                s, std::format("Failed to fetch {} messages from [{}].", batch_size, subject())
+            ));
+        }
+        return span<NatsMessageView>(batch);
+    }
+
+    /**
+     * Acknowledges all messages, the acks are written together by the connection flusher.
+     */
+    expected<void, NatsError> ack(span<const NatsMessageView> msgs) noexcept
+    {
+        for (const NatsMessageView& msg : msgs)
+        {
+            if (!msg.ptr)
+                continue; // moved out
+            auto res = msg.ack();
+            if (!res)
+                return res;
+        }
+        return {}; // Success
+    }
+
+    /**
+     * Acknowledges only the last message, which acknowledges the whole batch
+     * for consumers with the `AckAll` policy.
+     */
+    expected<void, NatsError> ack_last(span<const NatsMessageView> msgs) noexcept
+    {
+        for (size_t i = msgs.size(); i > 0; --i)
+        {
+            if (msgs[i - 1].ptr)
+                return msgs[i - 1].ack();
+        }
+        return {}; // Success
+    }
+
+    string_view subject() const noexcept
+    {
+        return string_view(natsSubscription_GetSubject(ptr));
+    }
+
+    bool is_valid() const noexcept
+    {
+        return natsSubscription_IsValid(ptr);
+    }
+};
+} // namespace nats
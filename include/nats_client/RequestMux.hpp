@@ -0,0 +1,601 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <charconv>
+#include <optional>
+#include <expected>
+#include <bit>
+#include <format>
+#include <thread>
+#include <stop_token>
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <coroutine>
+#include <nats/nats.h>
+
+#include "Error.hpp"
+#include "Coroutine.hpp"
+#include "MessageView.hpp"
+#include "SubscriptionAsync.hpp"
+
+namespace nats
+{
+using std::string;
+using std::string_view;
+using std::optional;
+using std::vector;
+using std::expected;
+using std::unexpected;
+
+class NatsClient;
+struct NatsPendingRequest;
+template <NatsExecutor Executor>
+struct NatsRequestAwaitable;
+
+/**
+ * Routes replies of all requests of a connection through a single
+ * wildcard inbox subscription `<inbox>.*`.
+ *
+ * Each request claims a slot in a fixed-size table of pre-allocated waiters,
+ * and its reply subject is `<inbox>.<token>`, where the token encodes the slot index
+ * and a sequence number. Claiming a slot and routing a reply to it are lock-free
+ * (CAS on the slot state), only a blocked waiter is woken up via its own mutex/condvar.
+ *
+ * Awaited requests (`NatsRequestAwaitable`) register a completion in their slot instead
+ * of blocking, their timeouts are enforced by a sweeper thread started on first use.
+ * It sleeps until the earliest armed deadline, or indefinitely if none is armed.
+ *
+ * Created by `NatsClient::enable_requests`.
+ */
+class NatsRequestMux
+{
+private:
+    friend class NatsClient;
+    friend struct NatsPendingRequest;
+    template <NatsExecutor Executor>
+    friend struct NatsRequestAwaitable;
+
+    // Slot state: 0 if free, otherwise the token of the request, with flag bits.
+    // Token layout: [sequence:32][marker:1][slot index:29][busy:1][done:1]
+    static constexpr uint64_t done_bit = 1;
+    static constexpr uint64_t busy_bit = 2;
+    static constexpr uint64_t flag_bits = done_bit | busy_bit;
+    static constexpr int index_shift = 2;
+    static constexpr uint64_t marker_bit = uint64_t{1} << 31;
+    static constexpr int sequence_shift = 32;
+    static constexpr size_t max_capacity = size_t{1} << 29;
+    static constexpr size_t max_prefix_size = 64;
+
+    /**
+     * Resumes an awaiting coroutine once its slot is done.
+     */
+    struct Completion
+    {
+        void (*resume)(Completion* self) noexcept;
+    };
+
+    // marks a slot whose completion already happened
+    static inline Completion done_sentinel{nullptr};
+
+    struct Waiter
+    {
+        std::atomic<uint64_t> state{0};
+        // written by the delivery thread before setting `done_bit`,
+        // stays `nullptr` if an awaited request timed out
+        natsMsg* reply = nullptr;
+        std::mutex mu;
+        std::condition_variable cv;
+        // only used by awaited requests, exchanged under `mu`
+        std::atomic<Completion*> completion{nullptr};
+    };
+
+    struct Deadline
+    {
+        int64_t deadline_ns;
+        uint64_t token;
+
+        bool operator>(const Deadline& other) const noexcept
+        {
+            return deadline_ns > other.deadline_ns;
+        }
+    };
+
+    struct ReplyHandler
+    {
+        NatsRequestMux* mux;
+
+        void operator()(NatsMessageView& msg) noexcept
+        {
+            mux->deliver(msg);
+        }
+    };
+
+    std::unique_ptr<Waiter[]> waiters;
+    uint64_t mask;
+    std::atomic<uint64_t> cursor{0};
+    std::atomic<uint64_t> sequence{0};
+    string prefix;
+    std::once_flag sweeper_started;
+    std::mutex sweep_mu;
+    std::condition_variable_any sweep_cv;
+    // min-heap of armed deadlines, entries of requests completed early are dropped
+    // when they expire or when the heap is compacted
+    vector<Deadline> deadlines;
+    // declared after the state it uses, so it is stopped first
+    std::jthread sweeper;
+    // declared last, so it is destroyed (and delivery stopped) before the waiters
+    optional<NatsSubscriptionAsync<ReplyHandler>> sub;
+
+    NatsRequestMux(size_t capacity, string&& inbox) noexcept //
+        : waiters(new Waiter[capacity]), mask(capacity - 1), prefix(std::move(inbox))
+    {
+    }
+
+    /**
+     * Maximum size of a reply subject, including NUL terminator.
+     */
+    static constexpr size_t reply_size = max_prefix_size + 1 + 20 + 1;
+
+    static size_t index_of(uint64_t token) noexcept
+    {
+        return static_cast<size_t>((token & (marker_bit - 1)) >> index_shift);
+    }
+
+    /**
+     * Creates the mux state for `NatsClient::enable_requests`,
+     * the inbox subscription is set up by the client.
+     */
+    static expected<std::unique_ptr<NatsRequestMux>, NatsError> create(size_t max_in_flight
+    ) noexcept
+    {
+        if (max_in_flight == 0 || max_in_flight > max_capacity)
+        {
+            return unexpected(NatsError(
+                NATS_INVALID_ARG,
+                std::format("Max. in-flight requests must be in [1, {}].", max_capacity)
+            ));
+        }
+
+        natsInbox* inbox = nullptr;
+        natsStatus s = natsInbox_Create(&inbox);
+        if (s != NATS_OK)
+            return unexpected(NatsError(s, "Failed to create request inbox."));
+        string inbox_str(inbox);
+        natsInbox_Destroy(inbox);
+
+        if (inbox_str.size() > max_prefix_size)
+        {
+            return unexpected(NatsError(
+                NATS_INVALID_ARG, std::format("Request inbox [{}] is too long.", inbox_str)
+            ));
+        }
+
+        return std::unique_ptr<NatsRequestMux>(
+            new NatsRequestMux(std::bit_ceil(max_in_flight), std::move(inbox_str))
+        );
+    }
+
+    string wildcard() const
+    {
+        return prefix + ".*";
+    }
+
+    /**
+     * Claims a free waiter slot and returns its token.
+     */
+    expected<uint64_t, NatsError> acquire() noexcept
+    {
+        uint64_t seq = sequence.fetch_add(1, std::memory_order_relaxed);
+        for (uint64_t probe = 0; probe <= mask; ++probe)
+        {
+            uint64_t idx = cursor.fetch_add(1, std::memory_order_relaxed) & mask;
+            uint64_t token = (seq << sequence_shift) | marker_bit | (idx << index_shift);
+            uint64_t free_state = 0;
+            Waiter& w = waiters[idx];
+            if (w.state.compare_exchange_strong(free_state, token, std::memory_order_acq_rel))
+            {
+                w.reply = nullptr;
+                w.completion.store(nullptr, std::memory_order_relaxed);
+                return token;
+            }
+        }
+        return unexpected(NatsError(
+            NATS_INSUFFICIENT_BUFFER,
+            std::format("Too many requests in flight, max. is {}.", mask + 1)
+        ));
+    }
+
+    /**
+     * Writes the NUL-terminated reply subject for the token into `buf`.
+     */
+    void reply_subject(uint64_t token, char (&buf)[reply_size]) const noexcept
+    {
+        std::memcpy(buf, prefix.data(), prefix.size());
+        char* p = buf + prefix.size();
+        *p++ = '.';
+        p = std::to_chars(p, buf + reply_size - 1, token).ptr;
+        *p = '\0';
+    }
+
+    /**
+     * Called on the delivery thread of the inbox subscription.
+     */
+    void deliver(NatsMessageView& msg) noexcept
+    {
+        string_view subject = msg.subject();
+        size_t dot = subject.rfind('.');
+        if (dot == string_view::npos)
+            return;
+
+        uint64_t token = 0;
+        const char* first = subject.data() + dot + 1;
+        const char* last = subject.data() + subject.size();
+        auto [end, ec] = std::from_chars(first, last, token);
+        if (ec != std::errc() || end != last || (token & flag_bits) != 0)
+            return;
+
+        Waiter& w = waiters[index_of(token) & mask];
+
+        // fails for replies of timed out or cancelled requests, and for duplicate replies
+        uint64_t pending_state = token;
+        if (!w.state.compare_exchange_strong(
+                pending_state, token | busy_bit, std::memory_order_acq_rel
+            ))
+            return;
+
+        w.reply = msg.ptr;
+        msg.ptr = nullptr;
+        complete(w, token);
+    }
+
+    /**
+     * Marks a slot owned via `busy_bit` as done and wakes up its waiter.
+     *
+     * The completion is taken together with setting `done_bit`: once that is visible, the
+     * slot may be released and claimed by another request, so it is not touched afterwards.
+     */
+    static void complete(Waiter& w, uint64_t token) noexcept
+    {
+        Completion* c = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(w.mu);
+            c = w.completion.exchange(&done_sentinel, std::memory_order_acq_rel);
+            w.state.store(token | done_bit, std::memory_order_release);
+        }
+        w.cv.notify_one();
+
+        if (c)
+            c->resume(c);
+    }
+
+    static int64_t now_ns() noexcept
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch()
+        )
+            .count();
+    }
+
+    /**
+     * Sets the deadline of an awaited request, after which it completes without reply.
+     */
+    void arm_deadline(uint64_t token, int64_t timeout_ms) noexcept
+    {
+        std::call_once(
+            sweeper_started,
+            [this]() { sweeper = std::jthread([this](std::stop_token stop) { sweep(stop); }); }
+        );
+        Deadline d{now_ns() + timeout_ms * 1'000'000, token};
+
+        bool earliest = false;
+        {
+            std::lock_guard<std::mutex> lock(sweep_mu);
+            if (deadlines.size() > 2 * capacity())
+            {
+                // at most `capacity()` entries belong to requests still pending
+                std::erase_if(
+                    deadlines,
+                    [this](const Deadline& e)
+                    {
+                        return waiters[index_of(e.token)].state.load(std::memory_order_acquire) !=
+                               e.token;
+                    }
+                );
+                std::make_heap(deadlines.begin(), deadlines.end(), std::greater<>());
+            }
+            earliest = deadlines.empty() || d.deadline_ns < deadlines.front().deadline_ns;
+            deadlines.push_back(d);
+            std::push_heap(deadlines.begin(), deadlines.end(), std::greater<>());
+        }
+        if (earliest)
+            sweep_cv.notify_one();
+    }
+
+    /**
+     * Completes awaited requests whose deadline has passed.
+     */
+    void sweep(std::stop_token stop) noexcept
+    {
+        std::unique_lock<std::mutex> lock(sweep_mu);
+        while (!stop.stop_requested())
+        {
+            if (deadlines.empty())
+            {
+                sweep_cv.wait(lock, stop, [this]() { return !deadlines.empty(); });
+                continue;
+            }
+
+            int64_t next = deadlines.front().deadline_ns;
+            if (now_ns() < next)
+            {
+                // woken up early if an earlier deadline is armed
+                sweep_cv.wait_until(
+                    lock,
+                    stop,
+                    std::chrono::steady_clock::time_point(std::chrono::nanoseconds(next)),
+                    [&]() { return deadlines.front().deadline_ns < next; }
+                );
+                continue;
+            }
+
+            std::pop_heap(deadlines.begin(), deadlines.end(), std::greater<>());
+            uint64_t token = deadlines.back().token;
+            deadlines.pop_back();
+            lock.unlock();
+
+            // fails if the request completed in the meantime, even if the slot was reused
+            Waiter& w = waiters[index_of(token)];
+            uint64_t pending_state = token;
+            // races with `deliver`, whoever sets `busy_bit` completes the slot
+            if (w.state.compare_exchange_strong(
+                    pending_state, token | busy_bit, std::memory_order_acq_rel
+                ))
+                complete(w, token);
+
+            lock.lock();
+        }
+    }
+
+    /**
+     * Registers the completion of an awaited request.
+     * Returns `false` if the request is already done and must not be suspended.
+     */
+    bool suspend(uint64_t token, Completion* c) noexcept
+    {
+        Waiter& w = waiters[index_of(token)];
+        std::lock_guard<std::mutex> lock(w.mu);
+        return w.completion.exchange(c, std::memory_order_acq_rel) != &done_sentinel;
+    }
+
+    /**
+     * Takes the reply of a done slot and releases the slot.
+     */
+    expected<NatsMessageView, NatsError> take(uint64_t token) noexcept
+    {
+        Waiter& w = waiters[index_of(token)];
+        NatsMessageView reply(w.reply);
+        w.reply = nullptr;
+        w.state.store(0, std::memory_order_release);
+
+        if (!reply.ptr)
+            return unexpected(NatsError(NATS_TIMEOUT));
+        return check_no_responders(std::move(reply));
+    }
+
+    static expected<NatsMessageView, NatsError> check_no_responders(NatsMessageView&& reply
+    ) noexcept
+    {
+        // server responds with an empty status 503 message if there are no subscribers
+        if (reply.data_length() == 0)
+        {
+            auto res_status = reply.header("Status");
+            if (res_status && res_status.value() == "503")
+                return unexpected(NatsError(NATS_NO_RESPONDERS));
+        }
+        return std::move(reply);
+    }
+
+    /**
+     * Waits for the reply of the request with the given token and releases the slot.
+     */
+    expected<NatsMessageView, NatsError> wait(uint64_t token, int64_t timeout_ms) noexcept
+    {
+        Waiter& w = waiters[index_of(token)];
+        auto is_done = [&]() { return w.state.load(std::memory_order_acquire) & done_bit; };
+
+        std::unique_lock<std::mutex> lock(w.mu);
+        if (!w.cv.wait_for(lock, std::chrono::milliseconds(timeout_ms), is_done))
+        {
+            uint64_t pending_state = token;
+            if (w.state.compare_exchange_strong(pending_state, 0, std::memory_order_acq_rel))
+                return unexpected(NatsError(NATS_TIMEOUT));
+
+            // reply is being delivered right now
+            w.cv.wait(lock, is_done);
+        }
+        lock.unlock();
+
+        return take(token);
+    }
+
+    /**
+     * Releases the slot of a request whose reply is no longer of interest.
+     * For awaited requests, must only be called if the request was never suspended on.
+     */
+    void cancel(uint64_t token) noexcept
+    {
+        (void)wait(token, 0);
+    }
+
+public:
+    ~NatsRequestMux() = default;
+
+    // Disable copy and move, the address is used by the inbox subscription
+    NatsRequestMux(const NatsRequestMux&) = delete;
+    NatsRequestMux& operator=(const NatsRequestMux&) = delete;
+
+    /**
+     * Maximum number of requests in flight.
+     */
+    size_t capacity() const noexcept
+    {
+        return mask + 1;
+    }
+
+    /**
+     * Inbox prefix of the reply subjects.
+     */
+    string_view inbox() const noexcept
+    {
+        return prefix;
+    }
+};
+
+/**
+ * Request published by `NatsClient::request_async` whose reply is pending.
+ *
+ * Destroying it without calling `wait` cancels the request and releases its slot.
+ */
+struct NatsPendingRequest
+{
+private:
+    friend class NatsClient;
+
+    NatsRequestMux* mux = nullptr;
+    uint64_t token = 0;
+
+    NatsPendingRequest(NatsRequestMux* mux, uint64_t token) noexcept //
+        : mux(mux), token(token)
+    {
+    }
+
+public:
+    ~NatsPendingRequest() noexcept
+    {
+        if (mux)
+        {
+            mux->cancel(token);
+            mux = nullptr;
+        }
+    }
+
+    // Disable copy
+    NatsPendingRequest(const NatsPendingRequest&) = delete;
+    NatsPendingRequest& operator=(const NatsPendingRequest&) = delete;
+
+    // Enable move
+    NatsPendingRequest(NatsPendingRequest&& other) noexcept : mux(other.mux), token(other.token)
+    {
+        other.mux = nullptr;
+    }
+    NatsPendingRequest& operator=(NatsPendingRequest&& other) noexcept
+    {
+        if (this != &other)
+        {
+            if (mux)
+                mux->cancel(token);
+            mux = other.mux;
+            token = other.token;
+            other.mux = nullptr;
+        }
+        return *this;
+    }
+
+    /**
+     * Blocks until the reply arrives or the timeout is reached.
+     *
+     * Can be called once, afterwards the request is completed.
+     * A timeout is reported as status-only `NATS_TIMEOUT` error,
+     * no responders as `NATS_NO_RESPONDERS`.
+     */
+    expected<NatsMessageView, NatsError> wait(int64_t timeout_ms) noexcept
+    {
+        if (!mux)
+            return unexpected(NatsError(NATS_ILLEGAL_STATE, "Request already completed."));
+        NatsRequestMux* m = mux;
+        mux = nullptr;
+        return m->wait(token, timeout_ms);
+    }
+};
+
+/**
+ * Awaitable request returned by `NatsClient::request` with an executor,
+ * resolves to `expected<NatsMessageView, NatsError>`.
+ *
+ * The awaiting coroutine is resumed on the executor when the reply arrives
+ * or the timeout is reached. Not awaiting it cancels the request.
+ */
+template <NatsExecutor Executor>
+struct NatsRequestAwaitable : NatsRequestMux::Completion
+{
+private:
+    friend class NatsClient;
+
+    NatsRequestMux* mux = nullptr;
+    uint64_t token = 0;
+    Executor* executor = nullptr;
+    std::coroutine_handle<> handle;
+    optional<NatsError> error;
+    bool suspended = false;
+
+    static void resume_on_executor(NatsRequestMux::Completion* self) noexcept
+    {
+        auto* a = static_cast<NatsRequestAwaitable*>(self);
+        a->executor->post(a->handle);
+    }
+
+    NatsRequestAwaitable(NatsRequestMux* mux, uint64_t token, Executor& executor) noexcept
+        : NatsRequestMux::Completion{resume_on_executor},
+          mux(mux),
+          token(token),
+          executor(&executor)
+    {
+    }
+
+    NatsRequestAwaitable(NatsError&& err) noexcept
+        : NatsRequestMux::Completion{resume_on_executor}, error(std::move(err))
+    {
+    }
+
+public:
+    ~NatsRequestAwaitable()
+    {
+        if (mux && !suspended)
+            mux->cancel(token);
+    }
+
+    // Disable copy and move, the address is registered in the waiter slot
+    NatsRequestAwaitable(const NatsRequestAwaitable&) = delete;
+    NatsRequestAwaitable& operator=(const NatsRequestAwaitable&) = delete;
+
+    bool await_ready() noexcept
+    {
+        return error.has_value();
+    }
+
+    bool await_suspend(std::coroutine_handle<> h) noexcept
+    {
+        handle = h;
+        suspended = true;
+        return mux->suspend(token, this);
+    }
+
+    expected<NatsMessageView, NatsError> await_resume() noexcept
+    {
+        if (error)
+            return unexpected(std::move(*error));
+        NatsRequestMux* m = std::exchange(mux, nullptr);
+        return m->take(token);
+    }
+};
+} // namespace nats
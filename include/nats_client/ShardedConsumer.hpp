@@ -0,0 +1,313 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <atomic>
+#include <concepts>
+#include <memory>
+#include <span>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <expected>
+#include <format>
+#include <pthread.h>
+#include <sched.h>
+#include <nats/nats.h>
+
+#include "Client.hpp"
+#include "ClientPool.hpp"
+#include "Error.hpp"
+#include "MessageView.hpp"
+#include "SubscriptionSync.hpp"
+
+namespace nats
+{
+using std::span;
+using std::string_view;
+using std::vector;
+using std::expected;
+using std::unexpected;
+
+template <typename Handler>
+concept NatsShardHandler = std::copy_constructible<Handler> &&
+                           std::invocable<Handler&, NatsMessageView&, size_t>;
+
+/**
+ * Settings of a `NatsShardedConsumer`.
+ */
+struct NatsShardConfig
+{
+    // Number of shards, 0 for one per CPU the process may run on.
+    size_t shards = 0;
+    // Pin the thread of shard `i` to `cpus[i % cpus.size()]`, or to the i-th allowed CPU
+    // if empty.
+    bool pin = true;
+    vector<int> cpus{};
+    // Messages taken from the subscription per `next_msgs` call.
+    size_t batch_size = 64;
+    // How long a shard waits for messages before checking whether it should stop.
+    int64_t poll_timeout_ms = 100;
+    // Allocate the batch buffer on the shard thread after pinning, so that the kernel's
+    // first-touch policy places it on the NUMA node of the shard's CPU.
+    bool local_buffers = true;
+};
+
+/**
+ * Consumer spreading the messages of a subject over K queue group subscriptions,
+ * each drained in batches by its own thread pinned to a CPU.
+ *
+ * With a single subscription all messages funnel through one cnats queue. Here the server
+ * balances messages across the members of the queue group, so processing scales with the
+ * number of shards. Each shard owns a copy of the handler, which is called as
+ * `handler(msg, shard_index)` on the shard's thread: state kept in the handler is
+ * shard-local and needs no synchronization.
+ *
+ * Created on one client, all shards share its socket and reader thread. Created on a
+ * `NatsClientPool`, shard `i` uses connection `i % pool.size()`, so reading is spread too.
+ */
+template <NatsShardHandler Handler>
+class NatsShardedConsumer
+{
+private:
+    struct alignas(64) Shard
+    {
+        NatsSubscriptionSync sub;
+        Handler handler;
+        vector<NatsMessageView> batch;
+        std::atomic<uint64_t> received{0};
+        // times messages were dropped because the pending limits were reached
+        std::atomic<uint64_t> slow_consumer{0};
+        // NATS_OK while running, otherwise the status the shard stopped with
+        std::atomic<natsStatus> status{NATS_OK};
+        // true if the thread is running on its assigned CPU
+        std::atomic<bool> pinned{false};
+        std::jthread thread;
+
+        Shard(NatsSubscriptionSync&& sub, const Handler& handler) //
+            : sub(std::move(sub)), handler(handler)
+        {
+        }
+    };
+
+    // heap allocated, the shard threads refer to them
+    vector<std::unique_ptr<Shard>> shards;
+
+    NatsShardedConsumer() noexcept = default;
+
+    static vector<int> allowed_cpus() noexcept
+    {
+        vector<int> cpus;
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        if (sched_getaffinity(0, sizeof(set), &set) == 0)
+        {
+            for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+            {
+                if (CPU_ISSET(cpu, &set))
+                    cpus.push_back(cpu);
+            }
+        }
+        return cpus;
+    }
+
+    static void run(
+        std::stop_token stop, Shard& shard, size_t index, int cpu, NatsShardConfig config
+    ) noexcept
+    {
+        if (cpu >= 0)
+        {
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(cpu, &set);
+            bool ok = pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+            shard.pinned.store(ok, std::memory_order_relaxed);
+        }
+        if (config.local_buffers)
+            shard.batch = vector<NatsMessageView>(config.batch_size);
+
+        while (!stop.stop_requested())
+        {
+            auto res = shard.sub.next_msgs(shard.batch, config.poll_timeout_ms);
+            if (!res)
+            {
+                // reported once per overflow, messages were dropped but the subscription
+                // is still usable
+                if (res.error().status == NATS_SLOW_CONSUMER)
+                {
+                    shard.slow_consumer.fetch_add(1, std::memory_order_relaxed);
+                    continue;
+                }
+                // closed connection or subscription, also the way out of a blocked wait,
+                // the subscription is closed on stop
+                shard.status.store(res.error().status, std::memory_order_release);
+                return;
+            }
+            size_t n = res.value();
+            for (size_t i = 0; i < n; ++i)
+                shard.handler(shard.batch[i], index);
+            shard.received.fetch_add(n, std::memory_order_relaxed);
+        }
+    }
+
+    template <typename Subscribe>
+    static expected<NatsShardedConsumer, NatsError> start(
+        Subscribe&& subscribe, const Handler& handler, NatsShardConfig config
+    ) noexcept
+    {
+        vector<int> cpus = config.cpus.empty() ? allowed_cpus() : config.cpus;
+        size_t count = config.shards;
+        if (count == 0)
+            count = cpus.empty() ? 1 : cpus.size();
+        if (config.batch_size == 0)
+            config.batch_size = 1;
+
+        NatsShardedConsumer consumer;
+        consumer.shards.reserve(count);
+        for (size_t i = 0; i < count; ++i)
+        {
+            auto res = subscribe(i);
+            if (!res)
+                return unexpected(res.error());
+            consumer.shards.push_back(std::make_unique<Shard>(std::move(res.value()), handler));
+            if (!config.local_buffers)
+                consumer.shards.back()->batch = vector<NatsMessageView>(config.batch_size);
+        }
+
+        for (size_t i = 0; i < count; ++i)
+        {
+            int cpu = config.pin && !cpus.empty() ? cpus[i % cpus.size()] : -1;
+            Shard& shard = *consumer.shards[i];
+            shard.thread = std::jthread(
+                [&shard, i, cpu, config](std::stop_token stop)
+                { run(stop, shard, i, cpu, config); }
+            );
+        }
+        return consumer;
+    }
+
+    void stop() noexcept
+    {
+        for (auto& shard : shards)
+        {
+            shard->thread.request_stop();
+            // wakes up a shard waiting for messages
+            natsSubscription_Unsubscribe(shard->sub.ptr);
+        }
+        for (auto& shard : shards)
+        {
+            if (shard->thread.joinable())
+                shard->thread.join();
+        }
+        shards.clear();
+    }
+
+public:
+    /**
+     * Subscribes `config.shards` members of `queue_group` to `subject` on `client`
+     * and starts their threads.
+     */
+    static expected<NatsShardedConsumer, NatsError> create(
+        NatsClient& client,
+        string_view subject,
+        string_view queue_group,
+        const Handler& handler,
+        NatsShardConfig config = {}
+    ) noexcept
+    {
+        return start(
+            [&](size_t) { return client.queue_subscribe_sync(subject, queue_group); },
+            handler,
+            std::move(config)
+        );
+    }
+
+    /**
+     * Like above, shard `i` subscribing on connection `i % pool.size()` of the pool.
+     */
+    static expected<NatsShardedConsumer, NatsError> create(
+        NatsClientPool& pool,
+        string_view subject,
+        string_view queue_group,
+        const Handler& handler,
+        NatsShardConfig config = {}
+    ) noexcept
+    {
+        return start(
+            [&](size_t i)
+            { return pool.at(i % pool.size()).queue_subscribe_sync(subject, queue_group); },
+            handler,
+            std::move(config)
+        );
+    }
+
+    ~NatsShardedConsumer()
+    {
+        stop();
+    }
+
+    // Disable copy
+    NatsShardedConsumer(const NatsShardedConsumer&) = delete;
+    NatsShardedConsumer& operator=(const NatsShardedConsumer&) = delete;
+
+    // Enable move
+    NatsShardedConsumer(NatsShardedConsumer&& other) noexcept = default;
+    NatsShardedConsumer& operator=(NatsShardedConsumer&& other) noexcept
+    {
+        if (this != &other)
+        {
+            stop();
+            shards = std::move(other.shards);
+        }
+        return *this;
+    }
+
+    size_t size() const noexcept
+    {
+        return shards.size();
+    }
+
+    /**
+     * The subscription of a shard, e.g. to adjust its pending limits or read its stats.
+     */
+    NatsSubscriptionSync& subscription(size_t index) noexcept
+    {
+        return shards[index]->sub;
+    }
+
+    /**
+     * Messages handled by a shard so far.
+     */
+    uint64_t received(size_t index) const noexcept
+    {
+        return shards[index]->received.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * Times a shard fell behind and messages were dropped by the client, see
+     * `NatsSubscriptionSync::set_pending_limits`. The shard keeps running.
+     */
+    uint64_t slow_consumer(size_t index) const noexcept
+    {
+        return shards[index]->slow_consumer.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * `NATS_OK` while the shard runs, otherwise the status it stopped with
+     * (e.g. `NATS_CONNECTION_CLOSED`).
+     */
+    natsStatus status(size_t index) const noexcept
+    {
+        return shards[index]->status.load(std::memory_order_acquire);
+    }
+
+    /**
+     * True if the shard's thread is running on its assigned CPU.
+     */
+    bool pinned(size_t index) const noexcept
+    {
+        return shards[index]->pinned.load(std::memory_order_relaxed);
+    }
+};
+} // namespace nats
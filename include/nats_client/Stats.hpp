@@ -0,0 +1,270 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <mutex>
+#include <expected>
+#include <format>
+#include <iterator>
+#include <algorithm>
+#include <nats/nats.h>
+
+#include "Error.hpp"
+
+namespace nats
+{
+using std::string;
+using std::string_view;
+using std::vector;
+using std::expected;
+using std::unexpected;
+
+/**
+ * Connection counters, see `NatsClient::stats`.
+ */
+struct NatsConnectionStats
+{
+    uint64_t in_msgs{0};
+    uint64_t in_bytes{0};
+    uint64_t out_msgs{0};
+    uint64_t out_bytes{0};
+    uint64_t reconnects{0};
+
+    /**
+     * Reads the counters of a connection, filled by cnats under a single lock.
+     * `scratch` is a statistics object allocated by the caller and reused across calls.
+     */
+    static expected<NatsConnectionStats, NatsError> read(
+        natsConnection* conn, natsStatistics* scratch
+    ) noexcept
+    {
+        NatsConnectionStats st;
+        natsStatus s;
+        if ((s = natsConnection_GetStats(conn, scratch)) != NATS_OK ||
+            (s = natsStatistics_GetCounts(
+                 scratch, &st.in_msgs, &st.in_bytes, &st.out_msgs, &st.out_bytes, &st.reconnects
+             )) != NATS_OK)
+        {
+            return unexpected(NatsError(s, "Failed to get connection statistics."));
+        }
+        return st;
+    }
+};
+
+/**
+ * Subscription counters, see `NatsSubscriptionSync::stats`.
+ */
+struct NatsSubscriptionStats
+{
+    int pending_msgs{0};
+    int pending_bytes{0};
+    int max_pending_msgs{0};
+    int max_pending_bytes{0};
+    int64_t delivered_msgs{0};
+    int64_t dropped_msgs{0};
+
+    /**
+     * Reads the counters of a subscription, filled by cnats under a single lock.
+     */
+    static expected<NatsSubscriptionStats, NatsError> read(natsSubscription* sub) noexcept
+    {
+        NatsSubscriptionStats st;
+        natsStatus s = natsSubscription_GetStats(
+            sub,
+            &st.pending_msgs,
+            &st.pending_bytes,
+            &st.max_pending_msgs,
+            &st.max_pending_bytes,
+            &st.delivered_msgs,
+            &st.dropped_msgs
+        );
+        if (s != NATS_OK)
+        {
+            return unexpected(NatsError(
+                s,
+                std::format(
+                    "Failed to get statistics for subscription [{}].",
+                    natsSubscription_GetSubject(sub)
+                )
+            ));
+        }
+        return st;
+    }
+};
+
+/**
+ * Process-wide registry of connected clients, rendered in the Prometheus text format.
+ *
+ * `NatsClient` registers its connection on `connect` and unregisters it when destroyed,
+ * so a scrape handler only needs to call `render_prometheus`. Rendering reads the counters
+ * of every connection once, with a single cnats lock acquisition per connection.
+ */
+class NatsMetricsRegistry
+{
+private:
+    struct Entry
+    {
+        natsConnection* conn;
+        uint64_t id;
+        string name;
+    };
+
+    struct Sample
+    {
+        const Entry* entry;
+        NatsConnectionStats stats;
+        bool connected;
+    };
+
+    std::mutex mu;
+    vector<Entry> entries;
+    vector<Sample> samples; // reused across renders
+    natsStatistics* scratch = nullptr;
+    uint64_t next_id = 1;
+
+    NatsMetricsRegistry() noexcept = default;
+
+    ~NatsMetricsRegistry()
+    {
+        if (scratch)
+            natsStatistics_Destroy(scratch);
+    }
+
+    static void append_label(string& out, string_view value)
+    {
+        for (char c : value)
+        {
+            if (c == '\\' || c == '"')
+                out.push_back('\\');
+            if (c == '\n')
+            {
+                out.append("\\n");
+                continue;
+            }
+            out.push_back(c);
+        }
+    }
+
+    template <typename Value>
+    void append_family(
+        string& out, const char* metric, const char* type, const char* help, Value value
+    )
+    {
+        auto it = std::back_inserter(out);
+        std::format_to(it, "# HELP {} {}\n# TYPE {} {}\n", metric, help, metric, type);
+        for (const Sample& sample : samples)
+        {
+            std::format_to(it, "{}{{client=\"{}\"", metric, sample.entry->id);
+            if (!sample.entry->name.empty())
+            {
+                out.append(",name=\"");
+                append_label(out, sample.entry->name);
+                out.push_back('"');
+            }
+            std::format_to(it, "}} {}\n", value(sample));
+        }
+    }
+
+public:
+    // Disable copy and move
+    NatsMetricsRegistry(const NatsMetricsRegistry&) = delete;
+    NatsMetricsRegistry& operator=(const NatsMetricsRegistry&) = delete;
+
+    static NatsMetricsRegistry& instance() noexcept
+    {
+        static NatsMetricsRegistry registry;
+        return registry;
+    }
+
+    void add(natsConnection* conn, string_view name)
+    {
+        std::lock_guard<std::mutex> lock(mu);
+        entries.push_back(Entry{conn, next_id++, string(name)});
+    }
+
+    void remove(natsConnection* conn) noexcept
+    {
+        std::lock_guard<std::mutex> lock(mu);
+        std::erase_if(entries, [conn](const Entry& e) { return e.conn == conn; });
+    }
+
+    /**
+     * Appends the counters of all registered connections to `out`,
+     * reusing its capacity when called with the same buffer.
+     */
+    expected<void, NatsError> render_prometheus(string& out)
+    {
+        std::lock_guard<std::mutex> lock(mu);
+
+        natsStatus s;
+        if (!scratch && (s = natsStatistics_Create(&scratch)) != NATS_OK)
+            return unexpected(NatsError(s, "Failed to create statistics object."));
+
+        samples.clear();
+        for (const Entry& entry : entries)
+        {
+            auto res = NatsConnectionStats::read(entry.conn, scratch);
+            if (!res)
+                continue; // closing, skipped for this scrape
+            bool connected = natsConnection_Status(entry.conn) == NATS_CONN_STATUS_CONNECTED;
+            samples.push_back(Sample{&entry, res.value(), connected});
+        }
+
+        append_family(
+            out,
+            "nats_client_in_msgs_total",
+            "counter",
+            "Messages received by the connection.",
+            [](const Sample& x) { return x.stats.in_msgs; }
+        );
+        append_family(
+            out,
+            "nats_client_in_bytes_total",
+            "counter",
+            "Payload bytes received by the connection.",
+            [](const Sample& x) { return x.stats.in_bytes; }
+        );
+        append_family(
+            out,
+            "nats_client_out_msgs_total",
+            "counter",
+            "Messages sent by the connection.",
+            [](const Sample& x) { return x.stats.out_msgs; }
+        );
+        append_family(
+            out,
+            "nats_client_out_bytes_total",
+            "counter",
+            "Payload bytes sent by the connection.",
+            [](const Sample& x) { return x.stats.out_bytes; }
+        );
+        append_family(
+            out,
+            "nats_client_reconnects_total",
+            "counter",
+            "Reconnections of the connection.",
+            [](const Sample& x) { return x.stats.reconnects; }
+        );
+        append_family(
+            out,
+            "nats_client_connected",
+            "gauge",
+            "1 if the connection is currently connected.",
+            [](const Sample& x) { return x.connected ? 1 : 0; }
+        );
+        return {}; // Success
+    }
+
+    expected<string, NatsError> render_prometheus()
+    {
+        string out;
+        auto res = render_prometheus(out);
+        if (!res)
+            return unexpected(res.error());
+        return out;
+    }
+};
+} // namespace nats
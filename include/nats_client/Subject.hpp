@@ -0,0 +1,110 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <expected>
+#include <format>
+#include <nats/nats.h>
+
+#include "Error.hpp"
+
+namespace nats
+{
+using std::string;
+using std::string_view;
+using std::expected;
+using std::unexpected;
+
+/**
+ * Publish subject which is validated and NUL-terminated once at creation.
+ *
+ * Create subjects up-front for hot publish paths and pass them to
+ * `NatsClient::publish` instead of a `string_view`, which needs
+ * to be NUL-terminated and is checked again on every call.
+ */
+struct NatsSubject
+{
+private:
+    string str;
+
+    NatsSubject(string&& subject) noexcept //
+        : str(std::move(subject))
+    {
+    }
+
+public:
+    /**
+     * Validates and copies the subject.
+     *
+     * Subjects must be non-empty, consist of non-empty tokens separated by `.`,
+     * and must not contain whitespace or the wildcards `*` and `>`.
+     */
+    static expected<NatsSubject, NatsError> create(string_view subject) noexcept
+    {
+        if (subject.empty())
+            return unexpected(NatsError(NATS_INVALID_SUBJECT, "Subject is required."));
+
+        size_t token_len = 0;
+        for (char c : subject)
+        {
+            switch (c)
+            {
+                case ' ':
+                case '\t':
+                case '\r':
+                case '\n':
+                case '\0':
+                    return unexpected(NatsError(
+                        NATS_INVALID_SUBJECT,
+                        std::format("Subject [{}] must not contain whitespace.", subject)
+                    ));
+                case '*':
+                case '>':
+                    return unexpected(NatsError(
+                        NATS_INVALID_SUBJECT,
+                        std::format("Subject [{}] must not contain wildcards.", subject)
+                    ));
+                case '.':
+                    if (token_len == 0)
+                    {
+                        return unexpected(NatsError(
+                            NATS_INVALID_SUBJECT,
+                            std::format("Subject [{}] must not contain empty tokens.", subject)
+                        ));
+                    }
+                    token_len = 0;
+                    break;
+                default:
+                    ++token_len;
+                    break;
+            }
+        }
+
+        if (token_len == 0)
+        {
+            return unexpected(NatsError(
+                NATS_INVALID_SUBJECT,
+                std::format("Subject [{}] must not contain empty tokens.", subject)
+            ));
+        }
+
+        return NatsSubject(string(subject));
+    }
+
+    const char* c_str() const noexcept
+    {
+        return str.c_str();
+    }
+
+    size_t size() const noexcept
+    {
+        return str.size();
+    }
+
+    string_view view() const noexcept
+    {
+        return str;
+    }
+};
+} // namespace nats
@@ -0,0 +1,281 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <expected>
+#include <atomic>
+#include <concepts>
+#include <utility>
+#include <format>
+#include <nats/nats.h>
+
+#include "Error.hpp"
+#include "MessageView.hpp"
+#include "Stats.hpp"
+#include "PendingLimits.hpp"
+
+namespace nats
+{
+using std::string;
+using std::string_view;
+using std::expected;
+
+class NatsClient;
+
+/**
+ * Callable invoked for each message of an asynchronous subscription.
+ */
+template <typename Handler>
+concept NatsMessageHandler = std::invocable<Handler&, NatsMessageView&>;
+
+/**
+ * Asynchronous subscription which invokes the handler on the cnats delivery thread.
+ *
+ * The handler type is part of the subscription type, so messages are dispatched
+ * without type erasure. The handler receives a borrowed `NatsMessageView` which is
+ * destroyed after the handler returns, unless the handler moves it out.
+ *
+ * The destructor unsubscribes and blocks until the handler is no longer invoked,
+ * hence the subscription must not be destroyed from within its own handler.
+ * If the handler has a `void on_complete()` member, it is called once delivery has ended.
+ */
+template <NatsMessageHandler Handler>
+struct NatsSubscriptionAsync
+{
+private:
+    friend class NatsClient;
+
+    struct State
+    {
+        Handler handler;
+        std::atomic<bool> completed{false};
+    };
+
+    // heap-allocated once per subscription, address is passed as closure to cnats
+    State* state = nullptr;
+
+    template <typename H>
+        requires std::constructible_from<Handler, H>
+    explicit NatsSubscriptionAsync(H&& handler) //
+        : state(new State{std::forward<H>(handler)})
+    {
+    }
+
+    static void on_msg(
+        natsConnection* nc, natsSubscription* sub, natsMsg* msg, void* closure
+    ) noexcept
+    {
+        State* st = static_cast<State*>(closure);
+        NatsMessageView view(msg);
+        st->handler(view);
+    }
+
+    static void on_complete(void* closure) noexcept
+    {
+        State* st = static_cast<State*>(closure);
+        // optional hook, e.g. to wake up consumers waiting on the handler
+        if constexpr (requires(Handler& h) { h.on_complete(); })
+            st->handler.on_complete();
+        st->completed.store(true, std::memory_order_release);
+        st->completed.notify_all();
+    }
+
+    /**
+     * Called by `NatsClient` after subscribing.
+     * Registers the completion callback used to know when the handler can be released.
+     */
+    natsStatus set_on_complete() noexcept
+    {
+        s = natsSubscription_SetOnCompleteCB(ptr, on_complete, state);
+        if (s != NATS_OK)
+        {
+            // Without completion callback we can't tell when the delivery thread is done
+            // with the handler, so it is intentionally leaked instead of freed too early.
+            natsSubscription_Unsubscribe(ptr);
+            natsSubscription_Destroy(ptr);
+            ptr = nullptr;
+            state = nullptr;
+        }
+        return s;
+    }
+
+    void cleanup() noexcept
+    {
+        if (ptr)
+        {
+            if (adaptive_limits)
+                NatsPendingTuner::instance().remove(ptr);
+            // fails if already closed, in which case the completion callback has fired
+            natsSubscription_Unsubscribe(ptr);
+            state->completed.wait(false, std::memory_order_acquire);
+            natsSubscription_Destroy(ptr);
+            ptr = nullptr;
+        }
+        if (state)
+        {
+            delete state;
+            state = nullptr;
+        }
+    }
+
+    // registered with NatsPendingTuner, see set_adaptive_pending_limits
+    bool adaptive_limits = false;
+
+public:
+    natsSubscription* ptr = nullptr;
+    natsStatus s;
+
+    ~NatsSubscriptionAsync()
+    {
+        cleanup();
+    }
+
+    // Disable copy
+    NatsSubscriptionAsync(const NatsSubscriptionAsync&) = delete;
+    NatsSubscriptionAsync& operator=(const NatsSubscriptionAsync&) = delete;
+
+    // Enable move
+    NatsSubscriptionAsync(NatsSubscriptionAsync&& other) noexcept
+        : state(other.state),
+          adaptive_limits(std::exchange(other.adaptive_limits, false)),
+          ptr(other.ptr)
+    {
+        other.state = nullptr;
+        other.ptr = nullptr;
+    }
+    NatsSubscriptionAsync& operator=(NatsSubscriptionAsync&& other) noexcept
+    {
+        if (this != &other)
+        {
+            cleanup();
+            state = other.state;
+            adaptive_limits = std::exchange(other.adaptive_limits, false);
+            ptr = other.ptr;
+            other.state = nullptr;
+            other.ptr = nullptr;
+        }
+        return *this;
+    }
+
+    /**
+     * Returns the message handler.
+     *
+     * The handler is concurrently invoked on the delivery thread,
+     * access to its state must be synchronized.
+     */
+    Handler& handler() noexcept
+    {
+        return state->handler;
+    }
+
+    int64_t get_id() const noexcept
+    {
+        return natsSubscription_GetID(ptr);
+    }
+
+    string_view subject() const noexcept
+    {
+        const char* str = natsSubscription_GetSubject(ptr);
+        return string_view(str);
+    }
+
+    bool is_valid() const noexcept
+    {
+        return natsSubscription_IsValid(ptr);
+    }
+
+    expected<void, NatsError> no_delivery_delay() noexcept
+    {
+        if ((s = natsSubscription_NoDeliveryDelay(ptr)) != NATS_OK)
+            return std::unexpected(NatsError(s, "Failed to set no delivery delay."));
+        return {}; // Success
+    }
+
+    /**
+     * Stops delivery to the handler after the messages already received by the library.
+     */
+    expected<void, NatsError> drain() noexcept
+    {
+        if ((s = natsSubscription_Drain(ptr)) != NATS_OK)
+        {
+            return std::unexpected(
+                NatsError(s, std::format("Failed to drain subscription [{}].", subject()))
+            );
+        }
+        return {}; // Success
+    }
+
+    /**
+     * Returns pending, max pending, delivered and dropped counts in one snapshot.
+     */
+    expected<NatsSubscriptionStats, NatsError> stats() noexcept
+    {
+        return NatsSubscriptionStats::read(ptr);
+    }
+
+    expected<int64_t, NatsError> get_dropped() noexcept
+    {
+        int64_t count{0};
+        if ((s = natsSubscription_GetDropped(ptr, &count)) != NATS_OK)
+        {
+            return std::unexpected(NatsError(
+                s, std::format("Failed to get dropped count for subscription [{}].", subject())
+            ));
+        }
+        return count;
+    }
+
+    expected<int64_t, NatsError> get_delivered() noexcept
+    {
+        int64_t count{0};
+        if ((s = natsSubscription_GetDelivered(ptr, &count)) != NATS_OK)
+        {
+            return std::unexpected(NatsError(
+                s, std::format("Failed to get delivered count for subscription [{}].", subject())
+            ));
+        }
+        return count;
+    }
+
+    /**
+     * Sets fixed pending limits, leaving the adaptive mode if it was enabled.
+     */
+    expected<void, NatsError> set_pending_limits(int msgs, int bytes) noexcept
+    {
+        if (std::exchange(adaptive_limits, false))
+            NatsPendingTuner::instance().remove(ptr);
+        if ((s = natsSubscription_SetPendingLimits(ptr, msgs, bytes)) != NATS_OK)
+        {
+            return std::unexpected(NatsError(
+                s,
+                std::format(
+                    "Failed to set pending limits for subscription [{}] to {} msgs and {} bytes.",
+                    subject(),
+                    msgs,
+                    bytes
+                )
+            ));
+        }
+        return {}; // Success
+    }
+
+    /**
+     * Lets `NatsPendingTuner` adjust the pending limits to the backlog,
+     * see `NatsSubscriptionSync::set_adaptive_pending_limits`.
+     */
+    expected<void, NatsError> set_adaptive_pending_limits(
+        int min_msgs = 1024, int min_bytes = 1024 * 1024
+    ) noexcept
+    {
+        if (adaptive_limits)
+            return {}; // already registered
+        auto res = NatsPendingTuner::instance().add(ptr, min_msgs, min_bytes);
+        if (!res)
+            return res;
+        adaptive_limits = true;
+        return {}; // Success
+    }
+};
+} // namespace nats
@@ -3,11 +3,16 @@
 #include <cstddef>
 #include <string>
 #include <string_view>
+#include <span>
+#include <optional>
+#include <utility>
 #include <expected>
 #include <nats/nats.h>
 
 #include "Error.hpp"
 #include "MessageView.hpp"
+#include "Stats.hpp"
+#include "PendingLimits.hpp"
 
 // Regex: ^natsSubscription_[a-zA-Z0-9_]+
 // --------------------------------------
@@ -25,15 +30,15 @@
 // OK natsSubscription_GetDropped
 // OK natsSubscription_GetMaxPending
 // natsSubscription_ClearMaxPending
-// natsSubscription_GetStats
+// OK natsSubscription_GetStats
 // OK natsSubscription_IsValid
 // OK natsSubscription_Drain
 // OK natsSubscription_DrainTimeout
 // OK natsSubscription_WaitForDrainCompletion
 // OK natsSubscription_DrainCompletionStatus
-// natsSubscription_SetOnCompleteCB
+// OK natsSubscription_SetOnCompleteCB (used in NatsSubscriptionAsync)
 // natsSubscription_Fetch
-// natsSubscription_FetchRequest
+// OK natsSubscription_FetchRequest (used in JsPullSubscription)
 // natsSubscription_GetConsumerInfo
 // natsSubscription_GetSequenceMismatch
 // OK natsSubscription_Destroy
@@ -44,12 +49,20 @@ namespace nats
 using std::string;
 using std::string_view;
 using std::expected;
+using std::optional;
+using std::span;
 
 struct NatsSubscriptionSync
 {
     natsSubscription* ptr;
     natsStatus s;
 
+    // Error encountered by `next_msgs` after messages were already returned,
+    // reported on the next call instead of being lost.
+    natsStatus deferred_status = NATS_OK;
+    // registered with NatsPendingTuner, see set_adaptive_pending_limits
+    bool adaptive_limits = false;
+
     NatsSubscriptionSync(natsSubscription* sub) //
         : ptr(sub)
     {
@@ -59,6 +72,8 @@ struct NatsSubscriptionSync
     {
         if (ptr)
         {
+            if (adaptive_limits)
+                NatsPendingTuner::instance().remove(ptr);
             natsSubscription_Destroy(ptr);
             ptr = nullptr;
         }
@@ -69,7 +84,10 @@ struct NatsSubscriptionSync
     NatsSubscriptionSync& operator=(const NatsSubscriptionSync&) = delete;
 
     // Enable move
-    NatsSubscriptionSync(NatsSubscriptionSync&& other) noexcept : ptr(other.ptr)
+    NatsSubscriptionSync(NatsSubscriptionSync&& other) noexcept
+        : ptr(other.ptr),
+          deferred_status(other.deferred_status),
+          adaptive_limits(std::exchange(other.adaptive_limits, false))
     {
         other.ptr = nullptr;
     }
@@ -79,24 +97,101 @@ struct NatsSubscriptionSync
         {
             if (ptr)
             {
+                if (adaptive_limits)
+                    NatsPendingTuner::instance().remove(ptr);
                 natsSubscription_Destroy(ptr);
             }
             ptr = other.ptr;
+            deferred_status = other.deferred_status;
+            adaptive_limits = std::exchange(other.adaptive_limits, false);
             other.ptr = nullptr;
         }
         return *this;
     }
 
+    /**
+     * Returns the next available message, blocking until one arrives or the timeout is reached.
+     *
+     * A timeout is reported as a status-only `NATS_TIMEOUT` error, which does not allocate.
+     */
     expected<NatsMessageView, NatsError> next_msg(int64_t timeout_ms) noexcept
     {
         natsMsg* msg{nullptr};
 
         if ((s = natsSubscription_NextMsg(&msg, ptr, timeout_ms)) != NATS_OK)
+        {
+            if (s == NATS_TIMEOUT)
+                return std::unexpected(NatsError(s));
+            return std::unexpected(NatsError(s, "Failed to get next message from subscription."));
+        }
+
+        return NatsMessageView(msg);
+    }
+
+    /**
+     * Returns the next available message, blocking until one arrives or the timeout is reached.
+     *
+     * The result is `std::nullopt` (no error) if the timeout is reached,
+     * which makes polling loops with short timeouts allocation-free.
+     */
+    expected<optional<NatsMessageView>, NatsError> try_next_msg(int64_t timeout_ms) noexcept
+    {
+        natsMsg* msg{nullptr};
+
+        if ((s = natsSubscription_NextMsg(&msg, ptr, timeout_ms)) != NATS_OK)
+        {
+            if (s == NATS_TIMEOUT)
+                return std::nullopt;
             return std::unexpected(NatsError(s, "Failed to get next message from subscription."));
+        }
 
         return NatsMessageView(msg);
     }
 
+    /**
+     * Fills `out` with the available messages, waiting up to the timeout for the first one.
+     *
+     * After the first message, only messages already queued in the subscription
+     * are taken (non-blocking), up to `out.size()`.
+     * Returns the number of messages written to the front of `out`, 0 if the timeout is reached.
+     * Messages previously held by the slots of `out` are released when overwritten.
+     *
+     * If an error occurs after some messages were taken, these messages are returned
+     * and the error is reported by the next call.
+     */
+    expected<size_t, NatsError> next_msgs(span<NatsMessageView> out, int64_t timeout_ms) noexcept
+    {
+        if (deferred_status != NATS_OK)
+        {
+            s = deferred_status;
+            deferred_status = NATS_OK;
+            return std::unexpected(NatsError(s, "Failed to get next messages from subscription."));
+        }
+
+        size_t n = 0;
+        int64_t wait_ms = timeout_ms;
+        while (n < out.size())
+        {
+            natsMsg* msg{nullptr};
+            if ((s = natsSubscription_NextMsg(&msg, ptr, wait_ms)) != NATS_OK)
+            {
+                if (s == NATS_TIMEOUT)
+                    break;
+                if (n > 0)
+                {
+                    deferred_status = s;
+                    break;
+                }
+                return std::unexpected(
+                    NatsError(s, "Failed to get next messages from subscription.")
+                );
+            }
+            out[n++] = NatsMessageView(msg);
+            wait_ms = 0; // only drain what is already queued
+        }
+        return n;
+    }
+
     int64_t get_id() const noexcept
     {
         return natsSubscription_GetID(ptr);
@@ -180,6 +275,14 @@ struct NatsSubscriptionSync
         return natsSubscription_DrainCompletionStatus(ptr);
     }
 
+    /**
+     * Returns pending, max pending, delivered and dropped counts in one snapshot.
+     */
+    expected<NatsSubscriptionStats, NatsError> stats() noexcept
+    {
+        return NatsSubscriptionStats::read(ptr);
+    }
+
     struct MaxPending
     {
         int msgs{0};
@@ -259,8 +362,13 @@ struct NatsSubscriptionSync
         return p;
     }
 
+    /**
+     * Sets fixed pending limits, leaving the adaptive mode if it was enabled.
+     */
     expected<void, NatsError> set_pending_limits(int msgs, int bytes) noexcept
     {
+        if (std::exchange(adaptive_limits, false))
+            NatsPendingTuner::instance().remove(ptr);
         if ((s = natsSubscription_SetPendingLimits(ptr, msgs, bytes)) != NATS_OK)
         {
             return std::unexpected(NatsError(
@@ -275,5 +383,26 @@ struct NatsSubscriptionSync
         }
         return {}; // Success
     }
+
+    /**
+     * Lets `NatsPendingTuner` grow the pending limits while the backlog fills up and shrink
+     * them back once it drains, starting at (and never going below) the given limits.
+     * The bytes limits of all adaptive subscriptions share the tuner's process-wide budget.
+     *
+     * Fails with `NATS_INSUFFICIENT_BUFFER` if the budget cannot cover `min_bytes`.
+     * High-water marks are reported by `stats`, the current limits by `get_pending_limits`.
+     */
+    expected<void, NatsError> set_adaptive_pending_limits(
+        int min_msgs = 1024, int min_bytes = 1024 * 1024
+    ) noexcept
+    {
+        if (adaptive_limits)
+            return {}; // already registered
+        auto res = NatsPendingTuner::instance().add(ptr, min_msgs, min_bytes);
+        if (!res)
+            return res;
+        adaptive_limits = true;
+        return {}; // Success
+    }
 };
 } // namespace nats